@@ -25,6 +25,49 @@ using namespace concurrency;
 
 namespace cnuctran
 {
+    /*
+        Enums for the sparse matrix storage formats.
+        MFORMAT_HASH is the nested concurrent hash map (smatrix).
+        MFORMAT_CSR is the compressed sparse row format (csrmatrix).
+    */
+    enum mformat
+    {
+        MFORMAT_HASH = 0,
+        MFORMAT_CSR = 1
+    };
+
+    /*
+        Enums for the renumbering of the species before the transfer matrix is built.
+        RENUMBER_NONE keeps the order of the input.
+        RENUMBER_TOPOLOGICAL orders the blocks of the chain by decay direction, see solver::blocks.
+        RENUMBER_RCM is the reverse Cuthill-McKee ordering of the symmetrized chain graph.
+    */
+    enum rnumber
+    {
+        RENUMBER_NONE = 0,
+        RENUMBER_TOPOLOGICAL = 1,
+        RENUMBER_RCM = 2
+    };
+
+    /*
+        Enums for the floating-point type of the calculation, see scalar.h.
+    */
+    enum stype
+    {
+        STYPE_MPREAL = 0,
+        STYPE_DOUBLE = 1,
+        STYPE_LONG_DOUBLE = 2,
+        STYPE_FLOAT128 = 3,
+        STYPE_DD = 4,
+        STYPE_QD = 5,
+        STYPE_AUTO = 6,
+        STYPE_FPREAL = 7,
+        STYPE_FP128 = 8,
+        STYPE_FP192 = 9,
+        STYPE_FP256 = 10,
+        STYPE_FP512 = 11
+    };
+
     /*
 
         REUSABLE HIGH PRECISION CONSTANTS.
@@ -39,30 +82,44 @@ namespace cnuctran
         __dop__ is the decimal places of any printed mpreal numbers.
         __nop__ is an integer specifying no product.
         __vbs__ is the vervosity level; 0 (none), 1 (minimal), 2 (comprehensive)
+        __fmt__ is the sparse matrix storage used for the squaring, see mformat.
+        __typ__ is the floating-point type of the calculation, see stype.
+        __fxb__ is the number of fractional bits of the fixed-point squaring, 0 (disabled) by default.
+        __mxp__ is the number of digits checked by the mixed-precision squaring, 0 (disabled) by default.
+        __prn__ is 1 if the species unreachable from the initial composition are pruned, 1 by default.
+        __rnb__ is the renumbering of the species, see rnumber.
 
         REUSABLE DOUBLE CONSTANTS.
         __mnr__ is the minimum removal rate allowed in the calculation.
         __mxr__ is the maximum removal rate allowed in the calculation.
+        __lmp__ is the half-life, relative to the time step, below which a species is lumped, 0 (disabled) by default.
 
     */
 
     mpreal __eps__ = mpreal("1e-200", digits2bits(50));
     double __mnr__ = 1e-200;
     double __mxr__ = 1e+200;
+    double __lmp__ = 0;
     int    __dps__ = 45;
     const int    __dop__ = 16;
     const int    __npr__ = 1;
     const int    __nop__ = -1;
     int          __vbs__ = 0;
+    int          __fmt__ = MFORMAT_CSR;
+    int          __typ__ = STYPE_MPREAL;
+    int          __fxb__ = 0;
+    int          __mxp__ = 0;
+    int          __prn__ = 1;
+    int          __rnb__ = RENUMBER_NONE;
 
     /*
         Type definition for sparse matrix non-zero elements container.
-        The container is a nested unordered map.
+        The container is a nested unordered map of the floating-point type, real.
     */
-    typedef unordered_map<int, unordered_map<int, mpreal>> map_2d;
-    typedef unordered_map<int, mpreal> map_1d;
-    typedef concurrent_unordered_map<int, concurrent_unordered_map<int, mpreal>> cmap_2d;
-    typedef concurrent_unordered_map<int, mpreal> cmap_1d;
+    template <typename real> using map_2d = unordered_map<int, unordered_map<int, real>>;
+    template <typename real> using map_1d = unordered_map<int, real>;
+    template <typename real> using cmap_2d = concurrent_unordered_map<int, concurrent_unordered_map<int, real>>;
+    template <typename real> using cmap_1d = concurrent_unordered_map<int, real>;
 
     /*
         Enums for exceptions handling.
@@ -77,7 +134,8 @@ namespace cnuctran
         NUCLIDES_DATA_LOAD_FAILED = 6,
         XML_READING_ERROR = 7,
         UNEXPECTED_ERROR = 8,
-        MISSING_W0_SOURCE = 9
+        MISSING_W0_SOURCE = 9,
+        PRUNED_W0 = 10
 
     };
 
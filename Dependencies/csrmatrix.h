@@ -0,0 +1,330 @@
+/*
+*
+      This file is part of the CNUCTRAN library
+
+      @author   M. R. Omar (rabieomar@usm.my)
+      @license  MIT
+      @link     https://github.com/rabieomar92/cnuctran
+
+      Copyright (c) 2023, Universiti Sains Malaysia
+
+      This header file contains the definitions of CSRMATRIX class. CSRMATRIX stores the
+      sparse matrix in the compressed sparse row (CSR) format, i.e. a row pointer array,
+      a column index array and a contiguous array of values. Compared to the nested hash
+      map of SMATRIX, the squaring kernel walks contiguous memory and does not allocate a
+      hash node for every fill-in entry. CSRMATRIX is templated on the floating-point type,
+      real, see scalar.h.
+
+ */
+
+#ifndef CSRMATRIX_H
+#define CSRMATRIX_H
+
+#include <cnuctran.h>
+#include <smatrix.h>
+#include <scalar.h>
+#include <mpalloc.h>
+#include <ppl.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+using namespace mpfr;
+using namespace concurrency;
+
+
+
+namespace cnuctran
+{
+
+    /*
+        SPA is the per-thread dense sparse accumulator used by the row-wise Gustavson kernel.
+        acc holds one pre-initialized slot per column, mark[j] stores the stamp of the last
+        row that touched column j and occupied lists the columns touched by the current row.
+        tmp is the scratch operand receiving the products in the numeric kernel, so that the
+        multiply-add acc[j] += a * b does not create any temporary mpreal. The buffers are
+        kept alive and reused between rows and between squarings. bits is the precision of
+        acc and tmp; a squaring at another precision brings all of them to its precision,
+        since the zeroing of a slot keeps the precision of the slot.
+    */
+    template <typename real>
+    struct spa
+    {
+        vector<real> acc;
+        vector<int> mark;
+        vector<int> occupied;
+        int stamp = 0;
+        real tmp;
+        mpfr_prec_t bits = 0;
+
+        // Returns the accumulator of the calling thread, sized for ncols columns, at the precision bits.
+        static spa& local(int ncols, mpfr_prec_t bits)
+        {
+            static thread_local spa w;
+            if (w.bits != bits)
+            {
+                scalar<real>::prepare(w.tmp, bits);
+                for (real& slot : w.acc) scalar<real>::prepare(slot, bits);
+                w.bits = bits;
+            }
+            if ((int)w.acc.size() < ncols)
+            {
+                w.acc.resize(ncols, scalar<real>::zero(bits));
+                w.mark.resize(ncols, -1);
+            }
+            return w;
+        }
+    };
+
+    template <typename real>
+    class csrmatrix {
+
+    public:
+
+        std::pair<int, int> shape;
+
+        // row_ptr[i] .. row_ptr[i+1]-1 are the positions of row-i entries in col_idx and val.
+        // The column indices of each row are kept sorted in ascending order.
+        vector<int> row_ptr;
+        vector<int> col_idx;
+        vector<real> val;
+        mpfr_prec_t bits = digits2bits(__dps__);
+
+        /*
+            Constructor definitions.
+        */
+        csrmatrix(void) { return; }
+        csrmatrix(std::pair<int, int> shape)
+        {
+            this->shape = shape; this->row_ptr.assign(shape.first + 1, 0); return;
+        }
+
+        // Converts the nested map container (e.g. the one built by solver::prepare_transfer_matrix)
+        // into the CSR format.
+        csrmatrix(std::pair<int, int> shape, cmap_2d<real>& A)
+        {
+            this->shape = shape;
+            this->row_ptr.assign(shape.first + 1, 0);
+
+            vector<pair<int, const real*>> row;
+            for (int i = 0; i < shape.first; i++)
+            {
+                row.clear();
+                auto it = A.find(i);
+                if (it != A.end())
+                    for (const auto& [j, v] : it->second)
+                        row.push_back(make_pair(j, &v));
+                sort(row.begin(), row.end(),
+                    [](const pair<int, const real*>& a, const pair<int, const real*>& b) { return a.first < b.first; });
+                for (const auto& [j, v] : row)
+                {
+                    col_idx.push_back(j);
+                    val.push_back(*v);
+                }
+                row_ptr[i + 1] = (int)col_idx.size();
+            }
+            return;
+        }
+
+        csrmatrix(smatrix<real>& A) : csrmatrix(A.shape, A.nzel) { return; }
+
+        // Returns a copy of this matrix whose values are converted to the floating-point type,
+        // other. The conversion goes through mpreal.
+        template <typename other>
+        csrmatrix<other> convert(void) const
+        {
+            csrmatrix<other> result;
+            result.shape = shape;
+            result.row_ptr = row_ptr;
+            result.col_idx = col_idx;
+            result.bits = bits;
+            result.val.resize(val.size(), scalar<other>::zero(bits));
+            parallel_for(0, nnz(), [&](int p)
+                {
+                    mpreal::set_default_prec(bits);
+                    result.val[p] = scalar<other>::from_mpreal(scalar<real>::to_mpreal(val[p]));
+                });
+            return result;
+        }
+
+        int nnz(void) const { return (int)col_idx.size(); }
+
+        // Returns the element (i, j). Zero is returned if the element is not stored.
+        real get(int i, int j) const
+        {
+            auto first = col_idx.begin() + row_ptr[i];
+            auto last = col_idx.begin() + row_ptr[i + 1];
+            auto it = lower_bound(first, last, j);
+            if (it != last && *it == j)
+                return val[it - col_idx.begin()];
+            return scalar<real>::zero(bits);
+        }
+
+        // Converts back to the nested map container used by SMATRIX.
+        smatrix<real> to_smatrix(void) const
+        {
+            smatrix<real> result = smatrix<real>(shape);
+            for (int i = 0; i < shape.first; i++)
+                for (int p = row_ptr[i]; p < row_ptr[i + 1]; p++)
+                    result.nzel[i][col_idx[p]] = val[p];
+            return result;
+        }
+
+        bool same_pattern(const csrmatrix& other) const
+        {
+            return shape == other.shape && row_ptr == other.row_ptr && col_idx == other.col_idx;
+        }
+
+        /*
+            SYMBOLIC
+            Integer-only pass computing the sparsity pattern of (this x B) into C. C receives the row
+            pointers and the sorted column indices. The storage of C is reused: its vectors keep their
+            capacity and its existing value slots are kept, only missing slots are initialized.
+        */
+        void symbolic(const csrmatrix& B, csrmatrix& C) const
+        {
+            const int n = shape.first;
+            C.shape = std::pair<int, int>(n, B.shape.second);
+            C.bits = bits;
+            C.row_ptr.assign(n + 1, 0);
+
+//..........First pass counts the entries of every row of the product.
+            parallel_for(0, n, [&](int row)
+                {
+                    spa<real>& w = spa<real>::local(B.shape.second, bits);
+                    C.row_ptr[row + 1] = pattern_row(B, row, w);
+                });
+            for (int row = 0; row < n; row++)
+                C.row_ptr[row + 1] += C.row_ptr[row];
+
+//..........Second pass writes the sorted column indices.
+            C.col_idx.resize(C.row_ptr[n]);
+            parallel_for(0, n, [&](int row)
+                {
+                    spa<real>& w = spa<real>::local(B.shape.second, bits);
+                    pattern_row(B, row, w);
+                    sort(w.occupied.begin(), w.occupied.end());
+                    copy(w.occupied.begin(), w.occupied.end(), C.col_idx.begin() + C.row_ptr[row]);
+                });
+            C.val.resize(C.row_ptr[n], scalar<real>::zero(bits));
+        }
+
+        csrmatrix symbolic(const csrmatrix& B) const
+        {
+            csrmatrix result;
+            symbolic(B, result);
+            return result;
+        }
+
+        /*
+            NUMERIC
+            Computes the values of (this x B) into C, whose pattern must have been computed by
+            SYMBOLIC. The values of C are overwritten in place, no allocation takes place here.
+        */
+        void numeric(const csrmatrix& B, csrmatrix& C) const
+        {
+            parallel_for(0, shape.first, [&](int row)
+                {
+                    mpreal::set_default_prec(bits);
+                    spa<real>& w = spa<real>::local(B.shape.second, bits);
+                    for (int p = C.row_ptr[row]; p < C.row_ptr[row + 1]; p++)
+                        scalar<real>::set_zero(w.acc[C.col_idx[p]]);
+                    for (int p = row_ptr[row]; p < row_ptr[row + 1]; p++)
+                    {
+                        const int& k1 = col_idx[p];
+                        const real& v1 = val[p];
+                        for (int q = B.row_ptr[k1]; q < B.row_ptr[k1 + 1]; q++)
+                            scalar<real>::fma_acc(w.acc[B.col_idx[q]], v1, B.val[q], w.tmp);
+                    }
+                    for (int p = C.row_ptr[row]; p < C.row_ptr[row + 1]; p++)
+                        scalar<real>::assign(C.val[p], w.acc[C.col_idx[p]]);
+                });
+        }
+
+        csrmatrix mul(csrmatrix& other)
+        {
+            csrmatrix result = symbolic(other);
+            numeric(other, result);
+            return result;
+        }
+
+        // Parallel implementation of self sparse matrix-matrix multiplication.
+        csrmatrix smul(void)
+        {
+            return mul(*this);
+        }
+
+        // Implementation of exponentiation by squaring. The squaring ping-pongs between this
+        // matrix and a second persistent buffer, so at most two matrices are alive and their
+        // values are initialized once and only overwritten afterwards. The sparsity
+        // pattern of the powers stops growing after a few squarings. From then on, the symbolic
+        // pass is skipped and the squaring is numeric only.
+        void binpow(int k)
+        {
+            csrmatrix next;
+            bool saturated = false;
+            long long n_fma = 0, n_fma_total = 0;
+            auto t1 = chrono::high_resolution_clock::now();
+            for (int i = 1; i <= k; i++)
+            {
+                if (!saturated)
+                {
+                    symbolic(*this, next);
+                    saturated = next.same_pattern(*this);
+                    n_fma = products(*this);
+                    if (saturated && __vbs__ > 1)
+                        cout << "Sparsity pattern saturated after " << i - 1 << " squarings (nnz = " << nnz() << ")." << endl;
+                }
+                numeric(*this, next);
+                swap(*this, next);
+                n_fma_total += n_fma;
+                if (mpalloc::is_installed()) mpalloc::release();
+            }
+            auto t2 = chrono::high_resolution_clock::now();
+            if (__vbs__ > 1 && n_fma_total > 0)
+            {
+                stringstream ss;
+                ss << fixed << setprecision(1) << chrono::duration<double, nano>(t2 - t1).count() / n_fma_total;
+                cout << "Squaring performed " << n_fma_total << " multiply-adds, " << ss.str() << " ns per multiply-add." << endl;
+            }
+        }
+
+        // Returns the number of scalar multiply-adds needed by (this x B).
+        long long products(const csrmatrix& B) const
+        {
+            long long n = 0;
+            for (int k1 : col_idx)
+                n += B.row_ptr[k1 + 1] - B.row_ptr[k1];
+            return n;
+        }
+
+    private:
+
+        // Collects the distinct (unsorted) columns of row-i of (this x B) in w.occupied and
+        // returns their count.
+        int pattern_row(const csrmatrix& B, int i, spa<real>& w) const
+        {
+            const int stamp = ++w.stamp;
+            w.occupied.clear();
+            for (int p = row_ptr[i]; p < row_ptr[i + 1]; p++)
+            {
+                const int& k1 = col_idx[p];
+                for (int q = B.row_ptr[k1]; q < B.row_ptr[k1 + 1]; q++)
+                {
+                    const int& k2 = B.col_idx[q];
+                    if (w.mark[k2] != stamp)
+                    {
+                        w.mark[k2] = stamp;
+                        w.occupied.push_back(k2);
+                    }
+                }
+            }
+            return (int)w.occupied.size();
+        }
+
+    };
+}
+
+#endif
@@ -0,0 +1,319 @@
+/*
+
+      This file is part of the CNUCTRAN library
+
+      @author   M. R. Omar (rabieomar@usm.my)
+      @license  MIT
+      @link     https://github.com/rabieomar92/cnuctran
+
+      Copyright (c) 2023, Universiti Sains Malaysia
+
+      This header file contains the definitions of the double-double (DD_REAL, ~31 digits)
+      and quad-double (QD_REAL, ~62 digits) floating-point types. A number is stored as an
+      unevaluated sum of 2 or 4 non-overlapping doubles, and the arithmetic is built from
+      the error-free transformations TWO_SUM and TWO_PROD, following the algorithms of
+      Y. Hida, X. S. Li and D. H. Bailey, "Algorithms for quad-double precision floating
+      point arithmetic", Proc. 15th IEEE Symposium on Computer Arithmetic (2001).
+
+      The types live entirely on the stack and the addition and multiplication are fully
+      inlinable, which makes them an order of magnitude cheaper than MPFR at these
+      precisions. The exponential is only needed while building the transfer matrix and it
+      is evaluated through mpreal.
+
+ */
+
+#ifndef DDREAL_H
+#define DDREAL_H
+
+#include <mpreal.h>
+#include <cmath>
+
+using namespace mpfr;
+
+namespace cnuctran
+{
+
+    /*
+        ERROR-FREE TRANSFORMATIONS.
+        two_sum returns s = fl(a + b) and stores the exact error a + b - s in e.
+        quick_two_sum does the same, assuming |a| >= |b|.
+        two_prod returns p = fl(a * b) and stores the exact error a * b - p in e.
+    */
+    namespace eft
+    {
+        inline double two_sum(double a, double b, double& e)
+        {
+            double s = a + b;
+            double bb = s - a;
+            e = (a - (s - bb)) + (b - bb);
+            return s;
+        }
+
+        inline double quick_two_sum(double a, double b, double& e)
+        {
+            double s = a + b;
+            e = b - (s - a);
+            return s;
+        }
+
+        inline double two_prod(double a, double b, double& e)
+        {
+            double p = a * b;
+            e = std::fma(a, b, -p);
+            return p;
+        }
+
+        inline void three_sum(double& a, double& b, double& c)
+        {
+            double t1, t2, t3;
+            t1 = two_sum(a, b, t2);
+            a = two_sum(c, t1, t3);
+            b = two_sum(t2, t3, c);
+        }
+
+        inline void three_sum2(double& a, double& b, double& c)
+        {
+            double t1, t2, t3;
+            t1 = two_sum(a, b, t2);
+            a = two_sum(c, t1, t3);
+            b = t2 + t3;
+        }
+
+        // Renormalizes c0 + c1 + c2 + c3 (+ c4) into four non-overlapping components.
+        inline void renorm(double& c0, double& c1, double& c2, double& c3, double& c4)
+        {
+            double s0, s1, s2 = 0.0, s3 = 0.0;
+            if (std::isinf(c0)) return;
+
+            s0 = quick_two_sum(c3, c4, c4);
+            s0 = quick_two_sum(c2, s0, c3);
+            s0 = quick_two_sum(c1, s0, c2);
+            c0 = quick_two_sum(c0, s0, c1);
+
+            s0 = c0;
+            s1 = c1;
+            if (s1 != 0.0)
+            {
+                s1 = quick_two_sum(s1, c2, s2);
+                if (s2 != 0.0)
+                {
+                    s2 = quick_two_sum(s2, c3, s3);
+                    if (s3 != 0.0) s3 += c4;
+                    else s2 += c4;
+                }
+                else
+                {
+                    s1 = quick_two_sum(s1, c3, s2);
+                    if (s2 != 0.0) s2 = quick_two_sum(s2, c4, s3);
+                    else s1 = quick_two_sum(s1, c4, s2);
+                }
+            }
+            else
+            {
+                s0 = quick_two_sum(s0, c2, s1);
+                if (s1 != 0.0)
+                {
+                    s1 = quick_two_sum(s1, c3, s2);
+                    if (s2 != 0.0) s2 = quick_two_sum(s2, c4, s3);
+                    else s1 = quick_two_sum(s1, c4, s2);
+                }
+                else
+                {
+                    s0 = quick_two_sum(s0, c3, s1);
+                    if (s1 != 0.0) s1 = quick_two_sum(s1, c4, s2);
+                    else s0 = quick_two_sum(s0, c4, s1);
+                }
+            }
+
+            c0 = s0; c1 = s1; c2 = s2; c3 = s3;
+        }
+
+        inline void renorm(double& c0, double& c1, double& c2, double& c3)
+        {
+            double c4 = 0.0;
+            renorm(c0, c1, c2, c3, c4);
+        }
+    }
+
+
+    /*
+        DD_REAL
+        Double-double number, x = x[0] + x[1] with |x[1]| <= ulp(x[0]) / 2.
+    */
+    struct dd_real
+    {
+        double x[2];
+
+        dd_real(void) { x[0] = 0.0; x[1] = 0.0; }
+        dd_real(double hi) { x[0] = hi; x[1] = 0.0; }
+        dd_real(double hi, double lo) { x[0] = hi; x[1] = lo; }
+
+        dd_real operator-(void) const { return dd_real(-x[0], -x[1]); }
+
+        dd_real& operator+=(const dd_real& b)
+        {
+            double s1, s2, t1, t2;
+            s1 = eft::two_sum(x[0], b.x[0], s2);
+            t1 = eft::two_sum(x[1], b.x[1], t2);
+            s2 += t1;
+            s1 = eft::quick_two_sum(s1, s2, s2);
+            s2 += t2;
+            x[0] = eft::quick_two_sum(s1, s2, x[1]);
+            return *this;
+        }
+
+        dd_real& operator-=(const dd_real& b) { return *this += -b; }
+
+        dd_real& operator*=(const dd_real& b)
+        {
+            double p1, p2;
+            p1 = eft::two_prod(x[0], b.x[0], p2);
+            p2 += (x[0] * b.x[1] + x[1] * b.x[0]);
+            x[0] = eft::quick_two_sum(p1, p2, x[1]);
+            return *this;
+        }
+
+        dd_real& operator/=(const dd_real& b)
+        {
+            double q1, q2, q3;
+            dd_real r;
+            q1 = x[0] / b.x[0];
+            r = *this; r -= dd_real(q1) *= b;
+            q2 = r.x[0] / b.x[0];
+            r -= dd_real(q2) *= b;
+            q3 = r.x[0] / b.x[0];
+            q1 = eft::quick_two_sum(q1, q2, q2);
+            *this = dd_real(q1, q2);
+            return *this += dd_real(q3);
+        }
+    };
+
+    inline dd_real operator+(dd_real a, const dd_real& b) { return a += b; }
+    inline dd_real operator-(dd_real a, const dd_real& b) { return a -= b; }
+    inline dd_real operator*(dd_real a, const dd_real& b) { return a *= b; }
+    inline dd_real operator/(dd_real a, const dd_real& b) { return a /= b; }
+
+    inline bool operator==(const dd_real& a, const dd_real& b) { return a.x[0] == b.x[0] && a.x[1] == b.x[1]; }
+    inline bool operator!=(const dd_real& a, const dd_real& b) { return !(a == b); }
+    inline bool operator<(const dd_real& a, const dd_real& b) { return a.x[0] < b.x[0] || (a.x[0] == b.x[0] && a.x[1] < b.x[1]); }
+    inline bool operator>(const dd_real& a, const dd_real& b) { return b < a; }
+    inline bool operator<=(const dd_real& a, const dd_real& b) { return !(b < a); }
+    inline bool operator>=(const dd_real& a, const dd_real& b) { return !(a < b); }
+
+
+    /*
+        QD_REAL
+        Quad-double number, x = x[0] + x[1] + x[2] + x[3], with non-overlapping components.
+        The addition and multiplication are the "sloppy" variants of Hida et al., whose
+        error is bounded relative to the magnitude of the operands.
+    */
+    struct qd_real
+    {
+        double x[4];
+
+        qd_real(void) { x[0] = x[1] = x[2] = x[3] = 0.0; }
+        qd_real(double x0) { x[0] = x0; x[1] = x[2] = x[3] = 0.0; }
+        qd_real(double x0, double x1, double x2, double x3) { x[0] = x0; x[1] = x1; x[2] = x2; x[3] = x3; }
+
+        qd_real operator-(void) const { return qd_real(-x[0], -x[1], -x[2], -x[3]); }
+
+        qd_real& operator+=(const qd_real& b)
+        {
+            double s0, s1, s2, s3;
+            double t0, t1, t2, t3;
+
+            s0 = eft::two_sum(x[0], b.x[0], t0);
+            s1 = eft::two_sum(x[1], b.x[1], t1);
+            s2 = eft::two_sum(x[2], b.x[2], t2);
+            s3 = eft::two_sum(x[3], b.x[3], t3);
+
+            s1 = eft::two_sum(s1, t0, t0);
+            eft::three_sum(s2, t0, t1);
+            eft::three_sum2(s3, t0, t2);
+            t0 = t0 + t1 + t3;
+
+            eft::renorm(s0, s1, s2, s3, t0);
+            x[0] = s0; x[1] = s1; x[2] = s2; x[3] = s3;
+            return *this;
+        }
+
+        qd_real& operator-=(const qd_real& b) { return *this += -b; }
+
+        qd_real& operator*=(const qd_real& b)
+        {
+            const double* a = x;
+            double p0, p1, p2, p3, p4, p5;
+            double q0, q1, q2, q3, q4, q5;
+            double t0, t1;
+            double s0, s1, s2;
+
+            p0 = eft::two_prod(a[0], b.x[0], q0);
+
+            p1 = eft::two_prod(a[0], b.x[1], q1);
+            p2 = eft::two_prod(a[1], b.x[0], q2);
+
+            p3 = eft::two_prod(a[0], b.x[2], q3);
+            p4 = eft::two_prod(a[1], b.x[1], q4);
+            p5 = eft::two_prod(a[2], b.x[0], q5);
+
+//..........Start accumulation.
+            eft::three_sum(p1, p2, q0);
+
+//..........Six-three sum of p2, q1, q2, p3, p4, p5.
+            eft::three_sum(p2, q1, q2);
+            eft::three_sum(p3, p4, p5);
+            s0 = eft::two_sum(p2, p3, t0);
+            s1 = eft::two_sum(q1, p4, t1);
+            s2 = q2 + p5;
+            s1 = eft::two_sum(s1, t0, t0);
+            s2 += (t0 + t1);
+
+//..........O(eps^3) order terms.
+            s1 += a[0] * b.x[3] + a[1] * b.x[2] + a[2] * b.x[1] + a[3] * b.x[0] + q0 + q3 + q4 + q5;
+            eft::renorm(p0, p1, s0, s1, s2);
+            x[0] = p0; x[1] = p1; x[2] = s0; x[3] = s1;
+            return *this;
+        }
+
+        qd_real& operator/=(const qd_real& b)
+        {
+            double q0, q1, q2, q3;
+            qd_real r = *this;
+
+            q0 = r.x[0] / b.x[0];
+            r -= qd_real(q0) *= b;
+            q1 = r.x[0] / b.x[0];
+            r -= qd_real(q1) *= b;
+            q2 = r.x[0] / b.x[0];
+            r -= qd_real(q2) *= b;
+            q3 = r.x[0] / b.x[0];
+
+            eft::renorm(q0, q1, q2, q3);
+            x[0] = q0; x[1] = q1; x[2] = q2; x[3] = q3;
+            return *this;
+        }
+    };
+
+    inline qd_real operator+(qd_real a, const qd_real& b) { return a += b; }
+    inline qd_real operator-(qd_real a, const qd_real& b) { return a -= b; }
+    inline qd_real operator*(qd_real a, const qd_real& b) { return a *= b; }
+    inline qd_real operator/(qd_real a, const qd_real& b) { return a /= b; }
+
+    inline bool operator==(const qd_real& a, const qd_real& b)
+    {
+        return a.x[0] == b.x[0] && a.x[1] == b.x[1] && a.x[2] == b.x[2] && a.x[3] == b.x[3];
+    }
+    inline bool operator!=(const qd_real& a, const qd_real& b) { return !(a == b); }
+    inline bool operator<(const qd_real& a, const qd_real& b)
+    {
+        for (int i = 0; i < 4; i++)
+            if (a.x[i] != b.x[i]) return a.x[i] < b.x[i];
+        return false;
+    }
+    inline bool operator>(const qd_real& a, const qd_real& b) { return b < a; }
+    inline bool operator<=(const qd_real& a, const qd_real& b) { return !(b < a); }
+    inline bool operator>=(const qd_real& a, const qd_real& b) { return !(a < b); }
+
+}
+
+#endif
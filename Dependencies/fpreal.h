@@ -0,0 +1,227 @@
+/*
+
+      This file is part of the CNUCTRAN library
+
+      @author   M. R. Omar (rabieomar@usm.my)
+      @license  MIT
+      @link     https://github.com/rabieomar92/cnuctran
+
+      Copyright (c) 2023, Universiti Sains Malaysia
+
+      This header file contains the definitions of FPREAL class. FPREAL<N> is a binary
+      floating-point number whose significand of N limbs (N x 64 bits) is stored inline,
+      i.e. without any heap allocation, and whose precision is fixed at compile time. The
+      addition and the multiplication used by the sparse kernels are built directly on the
+      mpn routines of GMP/MPIR with fixed trip counts and round to nearest. The operations
+      that are only needed while building the transfer matrix (division, exponential and the
+      conversions) are delegated to MPFR through a custom view on the inline significand.
+
+      The representation follows MPFR: x = s * 0.d * 2^e, where the significand d is
+      normalized, i.e. the top bit of its most significant limb, d[N-1], is set.
+
+ */
+
+#ifndef FPREAL_H
+#define FPREAL_H
+
+#include <mpreal.h>
+#include <cstring>
+#include <utility>
+
+using namespace mpfr;
+
+namespace cnuctran
+{
+
+    template <int N>
+    struct fpreal
+    {
+        static const int limbs = N;
+        static const mpfr_prec_t bits = N * GMP_NUMB_BITS;
+
+        mp_limb_t d[N];
+        mpfr_exp_t e = 0;
+        int s = 0;          // Sign: +1, -1, or 0 for zero.
+
+        fpreal(void) { memset(d, 0, sizeof(d)); }
+        fpreal(int v) { memset(d, 0, sizeof(d)); view x(*this); mpfr_set_si(x.x, v, MPFR_RNDN); x.store(); }
+        fpreal(double v) { memset(d, 0, sizeof(d)); view x(*this); mpfr_set_d(x.x, v, MPFR_RNDN); x.store(); }
+
+        /*
+            VIEW
+            MPFR number sharing the inline significand of an FPREAL. The result of an MPFR
+            operation on the view is written back into the FPREAL by STORE.
+        */
+        struct view
+        {
+            mpfr_t x;
+            fpreal& r;
+
+            view(const fpreal& v) : r(const_cast<fpreal&>(v))
+            {
+                mpfr_custom_init_set(x, r.s == 0 ? MPFR_ZERO_KIND : (r.s > 0 ? MPFR_REGULAR_KIND : -MPFR_REGULAR_KIND),
+                    r.e, bits, r.d);
+            }
+
+            void store(void)
+            {
+                int kind = mpfr_custom_get_kind(x);
+                if (kind == MPFR_REGULAR_KIND || kind == -MPFR_REGULAR_KIND)
+                {
+                    r.s = kind > 0 ? 1 : -1;
+                    r.e = mpfr_custom_get_exp(x);
+                }
+                else
+                    r.s = 0;
+            }
+        };
+
+        fpreal operator-(void) const { fpreal r = *this; r.s = -r.s; return r; }
+
+        fpreal& operator+=(const fpreal& b) { add(*this, *this, b); return *this; }
+        fpreal& operator-=(const fpreal& b) { add(*this, *this, -b); return *this; }
+        fpreal& operator*=(const fpreal& b) { mul(*this, *this, b); return *this; }
+        fpreal& operator/=(const fpreal& b)
+        {
+            fpreal q;
+            view x(q);
+            mpfr_div(x.x, view(*this).x, view(b).x, MPFR_RNDN);
+            x.store();
+            return *this = q;
+        }
+
+        /*
+            MUL
+            r = a * b, rounded to nearest. r may alias a or b.
+        */
+        static void mul(fpreal& r, const fpreal& a, const fpreal& b)
+        {
+            if (a.s == 0 || b.s == 0) { r.s = 0; return; }
+            mp_limb_t p[2 * N];
+            mpn_mul_n(p, a.d, b.d, N);
+            mpfr_exp_t e = a.e + b.e;
+
+//..........The product of two normalized significands lies in [1/4, 1), hence at most one bit
+//          of normalization is needed.
+            if (!(p[2 * N - 1] & top_bit()))
+            {
+                mpn_lshift(p, p, 2 * N, 1);
+                e--;
+            }
+            r.s = a.s * b.s;
+            r.e = e;
+            round(r, p + N, p[N - 1]);
+        }
+
+        /*
+            ADD
+            r = a + b, rounded to nearest. r may alias a or b. The operands are aligned in N + 1
+            limbs, the extra limb guards the bits lost by the cancellation of close operands.
+        */
+        static void add(fpreal& r, const fpreal& a, const fpreal& b)
+        {
+            if (b.s == 0) { r = a; return; }
+            if (a.s == 0) { r = b; return; }
+
+//..........Orders the operands so that |x| >= |y|.
+            const fpreal* x = &a;
+            const fpreal* y = &b;
+            if (a.e < b.e || (a.e == b.e && mpn_cmp(a.d, b.d, N) < 0)) std::swap(x, y);
+
+            const mpfr_exp_t shift = x->e - y->e;
+            if (shift >= (mpfr_exp_t)((N + 1) * GMP_NUMB_BITS)) { r = *x; return; }
+
+            mp_limb_t u[N + 1], v[N + 1];
+            u[0] = 0;
+            memcpy(u + 1, x->d, sizeof(x->d));
+            align(v, y->d, (int)shift);
+
+            mpfr_exp_t e = x->e;
+            const int s = x->s;
+            if (x->s == y->s)
+            {
+                if (mpn_add_n(u, u, v, N + 1))
+                {
+                    mpn_rshift(u, u, N + 1, 1);
+                    u[N] |= top_bit();
+                    e++;
+                }
+            }
+            else
+            {
+                mpn_sub_n(u, u, v, N + 1);
+                int n = N;
+                while (n >= 0 && u[n] == 0) n--;
+                if (n < 0) { r.s = 0; return; }
+
+//..............Normalizes the difference, first by whole limbs and then by bits.
+                if (n < N)
+                {
+                    memmove(u + (N - n), u, (n + 1) * sizeof(mp_limb_t));
+                    memset(u, 0, (N - n) * sizeof(mp_limb_t));
+                    e -= (mpfr_exp_t)(N - n) * GMP_NUMB_BITS;
+                }
+                int z = leading_zeros(u[N]);
+                if (z > 0)
+                {
+                    mpn_lshift(u, u, N + 1, z);
+                    e -= z;
+                }
+            }
+            r.s = s;
+            r.e = e;
+            round(r, u + 1, u[0]);
+        }
+
+    private:
+
+        static mp_limb_t top_bit(void) { return (mp_limb_t)1 << (GMP_NUMB_BITS - 1); }
+
+        static int leading_zeros(mp_limb_t x)
+        {
+            int n = 0;
+            while (!(x & top_bit())) { x <<= 1; n++; }
+            return n;
+        }
+
+        // Writes the N limbs of y shifted right by shift bits into the N + 1 limbs of v, the
+        // limb below the significand included. The bits shifted out of v are truncated.
+        static void align(mp_limb_t* v, const mp_limb_t* y, int shift)
+        {
+            const int q = shift / GMP_NUMB_BITS;
+            const int b = shift % GMP_NUMB_BITS;
+            for (int i = 0; i <= N; i++)
+                v[i] = i + q >= 1 && i + q <= N ? y[i + q - 1] : 0;
+            if (b > 0) mpn_rshift(v, v, N + 1, b);
+        }
+
+        // Stores the N limbs of hi into r, rounded to nearest according to the limb below them.
+        static void round(fpreal& r, const mp_limb_t* hi, mp_limb_t below)
+        {
+            memcpy(r.d, hi, N * sizeof(mp_limb_t));
+            if (below & top_bit())
+            {
+                if (mpn_add_1(r.d, r.d, N, 1))
+                {
+                    r.d[N - 1] = top_bit();
+                    r.e++;
+                }
+            }
+        }
+    };
+
+    template <int N> inline fpreal<N> operator+(fpreal<N> a, const fpreal<N>& b) { return a += b; }
+    template <int N> inline fpreal<N> operator-(fpreal<N> a, const fpreal<N>& b) { return a -= b; }
+    template <int N> inline fpreal<N> operator*(fpreal<N> a, const fpreal<N>& b) { return a *= b; }
+    template <int N> inline fpreal<N> operator/(fpreal<N> a, const fpreal<N>& b) { return a /= b; }
+
+    template <int N> inline bool operator==(const fpreal<N>& a, const fpreal<N>& b)
+    {
+        if (a.s != b.s) return false;
+        return a.s == 0 || (a.e == b.e && mpn_cmp(a.d, b.d, N) == 0);
+    }
+    template <int N> inline bool operator!=(const fpreal<N>& a, const fpreal<N>& b) { return !(a == b); }
+
+}
+
+#endif
@@ -0,0 +1,155 @@
+/*
+
+      This file is part of the CNUCTRAN library
+
+      @author   M. R. Omar (rabieomar@usm.my)
+      @license  MIT
+      @link     https://github.com/rabieomar92/cnuctran
+
+      Copyright (c) 2023, Universiti Sains Malaysia
+
+      This header file contains the definitions of FXREAL class. FXREAL<F> is an unsigned
+      fixed-point number stored on F + 1 inline limbs, i.e. a big integer scaled by 2^(-64F):
+      the limbs d[0] .. d[F-1] hold the fraction and d[F] holds the integer part. Every entry
+      of the transfer matrix is a probability, possibly times a fission yield, hence it is
+      non-negative and bounded, and so are the entries of its powers. The multiply-add of the
+      squaring therefore needs no exponent handling at all, only one mpn multiplication and
+      one mpn addition.
+
+      The price is the absolute, rather than relative, resolution 2^(-64F). Small entries
+      lose significant bits and the entries below the resolution underflow to zero. REPORT
+      tells how many, so that one knows whether the fixed-point squaring is safe.
+
+ */
+
+#ifndef FXREAL_H
+#define FXREAL_H
+
+#include <mpreal.h>
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+using namespace mpfr;
+
+namespace cnuctran
+{
+
+    template <int F>
+    struct fxreal
+    {
+        static const int limbs = F + 1;
+        static const int frac_bits = F * GMP_NUMB_BITS;
+
+        mp_limb_t d[F + 1];
+
+        fxreal(void) { memset(d, 0, sizeof(d)); }
+
+        /*
+            FMA_ACC
+            c += a * b. The product is rounded to nearest. An overflow of the integer limb
+            is recorded, see OVERFLOWED.
+        */
+        static void fma_acc(fxreal& c, const fxreal& a, const fxreal& b)
+        {
+            mp_limb_t p[2 * (F + 1)];
+            mpn_mul_n(p, a.d, b.d, F + 1);
+
+//..........The product is scaled by 2^(-128F), its limbs F .. 2F are the fixed-point result
+//          and the limb F - 1 decides the rounding.
+            mp_limb_t cy = p[2 * F + 1];
+            if (p[F - 1] >> (GMP_NUMB_BITS - 1))
+                cy |= mpn_add_1(p + F, p + F, F + 1, 1);
+            cy |= mpn_add_n(c.d, c.d, p + F, F + 1);
+            if (cy) overflowed().store(true, memory_order_relaxed);
+        }
+
+        static atomic<bool>& overflowed(void) { static atomic<bool> b(false); return b; }
+
+        /*
+            Conversions from and to mpreal. The value x must lie in [0, 2^64).
+        */
+        static fxreal from_mpreal(const mpreal& x)
+        {
+            fxreal y;
+            if (x < 0 || (x > 0 && mpfr_get_exp(x.mpfr_srcptr()) > GMP_NUMB_BITS))
+            {
+                cout << "fatal-error <cnuctran.fxreal.from_mpreal(...)>\nThe value " << x
+                     << " cannot be represented in fixed point." << endl;
+                exit(1);
+            }
+            mpz_t z;
+            mpz_init(z);
+            mpreal s = x;
+            mpfr_mul_2si(s.mpfr_ptr(), x.mpfr_srcptr(), frac_bits, MPFR_RNDN);
+            mpfr_get_z(z, s.mpfr_srcptr(), MPFR_RNDN);
+            if (mpz_sizeinbase(z, 2) > (size_t)limbs * GMP_NUMB_BITS)
+                mpz_sub_ui(z, z, 1);
+            mpz_export(y.d, nullptr, -1, sizeof(mp_limb_t), 0, 0, z);
+            mpz_clear(z);
+            return y;
+        }
+
+        static mpreal to_mpreal(const fxreal& x, mpfr_prec_t bits)
+        {
+            mpz_t z;
+            mpz_init(z);
+            mpz_import(z, F + 1, -1, sizeof(mp_limb_t), 0, 0, x.d);
+            mpreal r = mpreal(0, bits);
+            mpfr_set_z_2exp(r.mpfr_ptr(), z, -frac_bits, MPFR_RNDN);
+            mpz_clear(z);
+            return r;
+        }
+
+        /*
+            REPORT
+            Prints the number of entries that underflowed to zero and the number of significant
+            bits kept by the smallest non-zero entry. Entries keeping fewer than bits significant
+            bits are counted as well. The structural non-zeros of a power of the transfer matrix
+            are all positive, hence a stored zero is always an underflow.
+        */
+        static void report(const vector<fxreal>& val, mpfr_prec_t bits)
+        {
+            if (overflowed().load())
+            {
+                cout << "fatal-error <cnuctran.fxreal.report(...)>\nAn entry of the transfer matrix power exceeded the fixed-point range." << endl;
+                exit(1);
+            }
+
+            long long n_zero = 0, n_short = 0;
+            int min_bits = limbs * GMP_NUMB_BITS;
+            for (const fxreal& v : val)
+            {
+                int n = significant_bits(v);
+                if (n == 0) { n_zero++; continue; }
+                if (n < bits) n_short++;
+                if (n < min_bits) min_bits = n;
+            }
+            cout << "Fixed-point squaring (" << frac_bits << " fractional bits): "
+                 << n_zero << " of " << val.size() << " entries underflowed to zero, "
+                 << n_short << " entries keep fewer than " << bits << " significant bits, "
+                 << "the smallest non-zero entry keeps " << min_bits << " bits." << endl;
+        }
+
+    private:
+
+        // Returns the number of bits below and including the leading one bit, 0 for zero.
+        static int significant_bits(const fxreal& v)
+        {
+            for (int i = F; i >= 0; i--)
+            {
+                if (v.d[i] == 0) continue;
+                int n = i * GMP_NUMB_BITS;
+                mp_limb_t x = v.d[i];
+                while (x != 0) { x >>= 1; n++; }
+                return n;
+            }
+            return 0;
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,233 @@
+/*
+
+      This file is part of the CNUCTRAN library
+
+      @author   M. R. Omar (rabieomar@usm.my)
+      @license  MIT
+      @link     https://github.com/rabieomar92/cnuctran
+
+      Copyright (c) 2023, Universiti Sains Malaysia
+
+      This header file contains the definitions of MPALLOC class. MPALLOC is a pooled
+      allocator for the limbs of MPFR numbers, installed through the custom memory
+      functions of GMP/MPFR. Every thread keeps its own free list of limb blocks sized
+      for the working precision, so the threads of parallel_for do not contend on the
+      global heap. MPALLOC also counts the allocations to report them per phase.
+
+ */
+
+#ifndef MPALLOC_H
+#define MPALLOC_H
+
+#include <mpreal.h>
+#include <cnuctran.h>
+#include <vector>
+#include <mutex>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+using namespace mpfr;
+
+namespace cnuctran
+{
+
+    class mpalloc
+    {
+    public:
+
+        /*
+            INSTALL
+            Installs the pooled allocator for the limbs of bits-precision MPFR numbers. Only the
+            blocks of exactly that size are pooled. The pool takes its blocks from, and returns
+            them to, the memory functions installed before, which also receive every other block.
+            Hence, all blocks live on the heap of the GMP/MPFR runtime, whether they were allocated
+            before the installation or not, e.g. those of __eps__ and of the constant caches of
+            MPFR. Installing it again with another precision only resizes the pooled blocks.
+        */
+        static void install(mpfr_prec_t bits)
+        {
+//..........MPFR stores the allocated size in one limb-sized header in front of the limbs.
+            size_t size = sizeof(mp_limb_t) + sizeof(mp_limb_t) * ((bits - 1) / GMP_NUMB_BITS + 1);
+            if (installed() && block_size() == size) return;
+            release();
+            block_size() = size;
+            if (!installed())
+            {
+                mp_get_memory_functions(&heap_allocate(), &heap_reallocate(), &heap_deallocate());
+                mp_set_memory_functions(allocate, reallocate, deallocate);
+                installed() = true;
+            }
+        }
+
+        static bool is_installed(void) { return installed(); }
+
+        /*
+            RELEASE
+            Returns all blocks held by the free lists of all threads to the heap. It must only be
+            called while no other thread is running MPFR arithmetic, i.e. between parallel loops.
+        */
+        static void release(void)
+        {
+            lock_guard<mutex> lock(registry_lock());
+            for (pool* p : registry())
+            {
+                for (void* b : p->blocks) heap_deallocate()(b, block_size());
+                p->blocks.clear();
+            }
+        }
+
+        /*
+            REPORT
+            Prints the allocations made since the previous report, labelled with the name of the
+            phase. It must only be called between parallel loops.
+        */
+        static void report(const string& phase)
+        {
+            if (!installed()) return;
+            counters total;
+            {
+                lock_guard<mutex> lock(registry_lock());
+                total = retired();
+                for (pool* p : registry()) total += p->count;
+            }
+            counters& last = reported();
+            cout << "Memory <" << phase << ">: "
+                 << total.allocs - last.allocs << " limb allocations ("
+                 << total.hits - last.hits << " from the pool), "
+                 << total.bytes - last.bytes << " bytes requested, "
+                 << total.heap_bytes - last.heap_bytes << " bytes from the heap." << endl;
+            last = total;
+        }
+
+    private:
+
+        struct counters
+        {
+            long long allocs = 0;
+            long long hits = 0;
+            long long bytes = 0;
+            long long heap_bytes = 0;
+
+            counters& operator+=(const counters& c)
+            {
+                allocs += c.allocs; hits += c.hits; bytes += c.bytes; heap_bytes += c.heap_bytes;
+                return *this;
+            }
+        };
+
+        // The free list and the counters of one thread. A pool registers itself on first use and
+        // hands its blocks back to the heap when the thread exits. Blocks released after that,
+        // e.g. by the destructors of global mpreal variables, go straight to the heap, i.e. to
+        // the memory functions in place before the installation.
+        struct pool
+        {
+            vector<void*> blocks;
+            counters count;
+
+            pool(void)
+            {
+                lock_guard<mutex> lock(registry_lock());
+                registry().push_back(this);
+            }
+
+            ~pool(void)
+            {
+                lock_guard<mutex> lock(registry_lock());
+                for (void* b : blocks) heap_deallocate()(b, block_size());
+                retired() += count;
+                auto& r = registry();
+                r.erase(std::remove(r.begin(), r.end(), this), r.end());
+                exited() = true;
+            }
+        };
+
+        static pool* local(void)
+        {
+            if (exited()) return nullptr;
+            static thread_local pool p;
+            return &p;
+        }
+
+        static bool& exited(void) { static thread_local bool e = false; return e; }
+
+        static void* allocate(size_t size)
+        {
+            pool* p = local();
+            if (p != nullptr)
+            {
+                p->count.allocs++;
+                p->count.bytes += size;
+                if (size == block_size() && !p->blocks.empty())
+                {
+                    void* b = p->blocks.back();
+                    p->blocks.pop_back();
+                    p->count.hits++;
+                    return b;
+                }
+                p->count.heap_bytes += size;
+            }
+            void* b = heap_allocate()(size);
+            if (b == nullptr)
+            {
+                cout << "fatal-error <cnuctran.mpalloc.allocate(...)>\nOut of memory while allocating " << size << " bytes." << endl;
+                exit(1);
+            }
+            return b;
+        }
+
+        static void* reallocate(void* ptr, size_t old_size, size_t new_size)
+        {
+            if (old_size != block_size() && new_size != block_size())
+            {
+                pool* p = local();
+                if (p != nullptr)
+                {
+                    p->count.allocs++;
+                    p->count.bytes += new_size;
+                    p->count.heap_bytes += new_size;
+                }
+                void* b = heap_reallocate()(ptr, old_size, new_size);
+                if (b == nullptr)
+                {
+                    cout << "fatal-error <cnuctran.mpalloc.reallocate(...)>\nOut of memory while allocating " << new_size << " bytes." << endl;
+                    exit(1);
+                }
+                return b;
+            }
+            void* b = allocate(new_size);
+            memcpy(b, ptr, old_size < new_size ? old_size : new_size);
+            deallocate(ptr, old_size);
+            return b;
+        }
+
+        static void deallocate(void* ptr, size_t size)
+        {
+            pool* p = local();
+            if (p != nullptr && size == block_size())
+                p->blocks.push_back(ptr);
+            else
+                heap_deallocate()(ptr, size);
+        }
+
+        // The memory functions of GMP/MPFR in place before the installation.
+        typedef void* (*allocate_function)(size_t);
+        typedef void* (*reallocate_function)(void*, size_t, size_t);
+        typedef void (*deallocate_function)(void*, size_t);
+        static allocate_function& heap_allocate(void) { static allocate_function f = nullptr; return f; }
+        static reallocate_function& heap_reallocate(void) { static reallocate_function f = nullptr; return f; }
+        static deallocate_function& heap_deallocate(void) { static deallocate_function f = nullptr; return f; }
+
+        static bool& installed(void) { static bool b = false; return b; }
+        static size_t& block_size(void) { static size_t s = 0; return s; }
+        static mutex& registry_lock(void) { static mutex m; return m; }
+        static vector<pool*>& registry(void) { static vector<pool*> r; return r; }
+        static counters& retired(void) { static counters c; return c; }
+        static counters& reported(void) { static counters c; return c; }
+    };
+}
+
+#endif
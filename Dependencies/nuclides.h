@@ -0,0 +1,659 @@
+/*
+
+      This file is part of the CNUCTRAN library
+
+      @author   M. R. Omar (rabieomar@usm.my)
+      @license  MIT
+      @link     https://github.com/rabieomar92/cnuctran
+
+      Copyright (c) 2023, Universiti Sains Malaysia
+
+      This header file contains the definitions of NUCLIDE_LIBRARY class. NUCLIDE_LIBRARY is
+      the in-memory image of a nuclides data file, i.e. the half-lives, the decay branches, the
+      reaction targets and the fission yields of every nuclide, indexed by nuclide name. A
+      library is loaded once per source file and it is shared read-only by all zones and
+      solvers. The numbers are kept as their exact decimal text, a zone only converts those of
+      the nuclides it tracks, at its own working precision.
+
+      The source is either an XML nuclides data file (e.g. chain_endfb71.xml) or its binary
+      image written by SAVE (see the -convert option of cnuctran). The binary image is the
+      in-memory layout itself: it is memory-mapped and used in place, without any parsing.
+
+          header      magic "CNUCLIB", version, byte order mark and the four counts below.
+          nuclides    n_nuclides records {name, half_life, first_event, n_events}.
+          events      n_events records {kind, type, target, branching_ratio, first_product,
+                      n_products}, the events of a nuclide are contiguous and in file order.
+          products    n_products records {name, yield}, the products of a fission event are
+                      contiguous and in file order.
+          strings     n_chars characters of null-terminated strings. The string fields of
+                      the records are offsets into this table, offset 0 is the empty string.
+
+      All the fields are 32-bit unsigned integers in the byte order of the machine that wrote
+      the image.
+
+ */
+
+#ifndef NUCLIDES_H
+#define NUCLIDES_H
+
+#include <mpreal.h>
+#include <pugixml.hpp>
+#include <cnuctran.h>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <iterator>
+#include <algorithm>
+#include <ppl.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace mpfr;
+using namespace pugi;
+
+namespace cnuctran
+{
+
+    /*
+        Enums for the kinds of removal event of a nuclide.
+    */
+    enum ekind
+    {
+        EVENT_DECAY = 0,
+        EVENT_REACTION = 1,
+        EVENT_FISSION = 2
+    };
+
+    /*
+        The records of a nuclide library. The string fields are offsets into the string table,
+        see nuclide_library::str. A decay has a target and a branching ratio, a reaction has a
+        type and a target, a fission has the products and the yields of the first tabulated
+        energy.
+    */
+    struct nuclide_record
+    {
+        uint32_t name;
+        uint32_t half_life;         // Empty for a stable nuclide.
+        uint32_t first_event;
+        uint32_t n_events;
+    };
+
+    struct event_record
+    {
+        uint32_t kind;
+        uint32_t type;
+        uint32_t target;
+        uint32_t branching_ratio;
+        uint32_t first_product;
+        uint32_t n_products;
+    };
+
+    struct product_record
+    {
+        uint32_t name;
+        uint32_t yield;
+    };
+
+    // A read-only range of records.
+    template <typename T>
+    struct record_range
+    {
+        const T* first = nullptr;
+        size_t n = 0;
+
+        const T* begin(void) const { return first; }
+        const T* end(void) const { return first + n; }
+        size_t size(void) const { return n; }
+        const T& operator[](size_t i) const { return first[i]; }
+    };
+
+    /*
+        MAPPED_FILE
+        A read-only memory mapping of a whole file, unmapped on destruction.
+    */
+    class mapped_file
+    {
+    public:
+
+        const char* data = nullptr;
+        size_t size = 0;
+
+        mapped_file(void) {}
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+#ifdef _WIN32
+        bool open(const string& path)
+        {
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER n;
+            if (!GetFileSizeEx(file, &n) || n.QuadPart == 0) return false;
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping == NULL) return false;
+            data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            size = data ? (size_t)n.QuadPart : 0;
+            return data != nullptr;
+        }
+
+        ~mapped_file(void)
+        {
+            if (data) UnmapViewOfFile(data);
+            if (mapping != NULL) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        }
+
+    private:
+
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = NULL;
+#else
+        bool open(const string& path)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); return false; }
+            void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (p == MAP_FAILED) return false;
+            data = (const char*)p;
+            size = (size_t)st.st_size;
+            return true;
+        }
+
+        ~mapped_file(void)
+        {
+            if (data) munmap((void*)data, size);
+        }
+#endif
+    };
+
+    class nuclide_library
+    {
+    public:
+
+        // The nuclides in the order of the nuclides data file.
+        record_range<nuclide_record> nuclides;
+
+        /*
+            GET
+            Returns the library of the nuclides data file, xml_data_location, either an XML file
+            or a binary image. The file is only loaded the first time it is requested. nullptr
+            is returned if the file cannot be loaded.
+        */
+        static shared_ptr<const nuclide_library> get(const string& xml_data_location)
+        {
+            auto& libraries = cache();
+            auto it = libraries.find(xml_data_location);
+            if (it != libraries.end())
+                return it->second;
+
+            shared_ptr<nuclide_library> library = make_shared<nuclide_library>();
+            bool loaded;
+            if (is_binary(xml_data_location))
+                loaded = library->load_binary(xml_data_location);
+            else
+            {
+                shared_ptr<const xml_source> src = parse(xml_data_location);
+                loaded = src && library->load_xml(*src, nullptr);
+            }
+            if (!loaded)
+                return nullptr;
+            library->build_index();
+            if (__vbs__) cout << "Nuclides data " << xml_data_location << " loaded, " << library->nuclides.size() << " nuclides." << endl;
+            libraries[xml_data_location] = library;
+            return library;
+        }
+
+        /*
+            GET
+            Returns a library of the nuclides data file, xml_data_location, that covers at least
+            the nuclides named in species. An XML file is parsed once, after which only the
+            records of these nuclides and of the fission products among them are built, hence a
+            small chain pays little for a large data file. The whole library is returned if it
+            is already loaded, or if the file is a binary image, which costs nothing to load.
+        */
+        static shared_ptr<const nuclide_library> get(const string& xml_data_location, const vector<string>& species)
+        {
+            auto& libraries = cache();
+            if (libraries.count(xml_data_location) || is_binary(xml_data_location))
+                return get(xml_data_location);
+
+            string key = xml_data_location;
+            for (const string& name : species) key += "\n" + name;
+            auto it = libraries.find(key);
+            if (it != libraries.end())
+                return it->second;
+
+            shared_ptr<const xml_source> src = parse(xml_data_location);
+            if (!src)
+                return nullptr;
+            unordered_set<string_view> tracked(species.begin(), species.end());
+            shared_ptr<nuclide_library> library = make_shared<nuclide_library>();
+            library->load_xml(*src, &tracked);
+            library->build_index();
+            if (__vbs__) cout << "Nuclides data " << xml_data_location << " loaded, " << library->nuclides.size() << " of " << src->nodes.size() << " nuclides." << endl;
+            libraries[key] = library;
+            return library;
+        }
+
+        /*
+            NAMES
+            Returns the names of all the nuclides of the nuclides data file, xml_data_location, in
+            file order, without building their records. The list is empty if the file cannot be
+            loaded.
+        */
+        static vector<string> names(const string& xml_data_location)
+        {
+            vector<string> names;
+            if (cache().count(xml_data_location) || is_binary(xml_data_location))
+            {
+                shared_ptr<const nuclide_library> library = get(xml_data_location);
+                if (library)
+                    for (const nuclide_record& x : library->nuclides) names.push_back(library->str(x.name));
+                return names;
+            }
+            shared_ptr<const xml_source> src = parse(xml_data_location);
+            if (src)
+                for (xml_node species : src->nodes) names.push_back(species.attribute("name").value());
+            return names;
+        }
+
+        // Returns the string at the offset off of the string table.
+        const char* str(uint32_t off) const { return strings + off; }
+
+        record_range<event_record> events(const nuclide_record& x) const { return { events_ + x.first_event, x.n_events }; }
+        record_range<product_record> products(const event_record& e) const { return { products_ + e.first_product, e.n_products }; }
+
+        // Returns the nuclide named name, nullptr if it is not in the library.
+        const nuclide_record* find(string_view name) const
+        {
+            auto it = index.find(name);
+            return it == index.end() ? nullptr : &nuclides[it->second];
+        }
+
+        /*
+            SAVE
+            Writes the binary image of the library to path. Returns false if path cannot be
+            written.
+        */
+        bool save(const string& path) const
+        {
+            ofstream out(path, ios::binary);
+            if (!out) return false;
+            header h = make_header();
+            h.n_nuclides = (uint32_t)nuclides.size();
+            h.n_events = n_events;
+            h.n_products = n_products;
+            h.n_chars = n_chars;
+            out.write((const char*)&h, sizeof(h));
+            out.write((const char*)nuclides.first, sizeof(nuclide_record) * h.n_nuclides);
+            out.write((const char*)events_, sizeof(event_record) * h.n_events);
+            out.write((const char*)products_, sizeof(product_record) * h.n_products);
+            out.write(strings, h.n_chars);
+            return (bool)out;
+        }
+
+    private:
+
+        struct header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;
+            uint32_t n_nuclides;
+            uint32_t n_events;
+            uint32_t n_products;
+            uint32_t n_chars;
+        };
+
+        static header make_header(void)
+        {
+            header h;
+            memset(&h, 0, sizeof(h));
+            memcpy(h.magic, "CNUCLIB", 8);
+            h.version = 1;
+            h.byte_order = 0x01020304;
+            return h;
+        }
+
+        // The records, either in the vectors below or in the mapped binary image.
+        const event_record* events_ = nullptr;
+        const product_record* products_ = nullptr;
+        const char* strings = nullptr;
+        uint32_t n_events = 0, n_products = 0, n_chars = 0;
+
+        vector<nuclide_record> nuclide_v;
+        vector<event_record> event_v;
+        vector<product_record> product_v;
+        vector<char> string_v;
+        mapped_file image;
+
+        // Maps a nuclide name to its position in nuclides. The keys view the string table.
+        unordered_map<string_view, int> index;
+
+        /*
+            XML_SOURCE
+            An XML nuclides data file parsed in situ, i.e. the strings of the document point into
+            text, and its nuclide nodes in file order.
+        */
+        struct xml_source
+        {
+            string text;
+            xml_document file;
+            vector<xml_node> nodes;
+        };
+
+        // The libraries, keyed by file for the whole libraries and by file and species otherwise.
+        static map<string, shared_ptr<const nuclide_library>>& cache(void)
+        {
+            static map<string, shared_ptr<const nuclide_library>> c;
+            return c;
+        }
+
+        // Returns the XML nuclides data file at path, parsed on the first request only.
+        static shared_ptr<const xml_source> parse(const string& path)
+        {
+            static map<string, shared_ptr<const xml_source>> sources;
+            auto it = sources.find(path);
+            if (it != sources.end())
+                return it->second;
+
+            shared_ptr<xml_source> src = make_shared<xml_source>();
+            ifstream in(path, ios::binary);
+            if (!in) return nullptr;
+            src->text.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+            if (src->text.empty() || !src->file.load_buffer_inplace(&src->text[0], src->text.size()))
+                return nullptr;
+            for (xml_node species : src->file.child("depletion").children())
+                src->nodes.push_back(species);
+            sources[path] = src;
+            return src;
+        }
+
+        static bool is_binary(const string& path)
+        {
+            char magic[8] = { 0 };
+            ifstream in(path, ios::binary);
+            in.read(magic, 8);
+            return in && memcmp(magic, make_header().magic, 8) == 0;
+        }
+
+        void build_index(void)
+        {
+            index.reserve(nuclides.size());
+            for (int i = 0; i < (int)nuclides.size(); i++)
+                index.emplace(string_view(str(nuclides[i].name)), i);
+        }
+
+        /*
+            LOAD_BINARY
+            Maps the binary image at path and points the records into it. The image is checked,
+            i.e. the counts must match the file size and every offset must stay inside its table.
+        */
+        bool load_binary(const string& path)
+        {
+            if (!image.open(path) || image.size < sizeof(header)) return false;
+            header h;
+            memcpy(&h, image.data, sizeof(h));
+            header expected = make_header();
+            if (h.version != expected.version || h.byte_order != expected.byte_order)
+            {
+                cout << "ERROR <cnuctran.nuclide_library.load_binary(...)>\n" << path << " was written by an incompatible version or machine, convert the XML file again." << endl;
+                return false;
+            }
+
+            const size_t size = sizeof(header) + sizeof(nuclide_record) * (size_t)h.n_nuclides +
+                sizeof(event_record) * (size_t)h.n_events + sizeof(product_record) * (size_t)h.n_products + h.n_chars;
+            if (size != image.size || h.n_chars == 0) return false;
+
+            const char* p = image.data + sizeof(header);
+            nuclides = { (const nuclide_record*)p, h.n_nuclides };  p += sizeof(nuclide_record) * h.n_nuclides;
+            events_ = (const event_record*)p;                        p += sizeof(event_record) * h.n_events;
+            products_ = (const product_record*)p;                    p += sizeof(product_record) * h.n_products;
+            strings = p;
+            n_events = h.n_events;
+            n_products = h.n_products;
+            n_chars = h.n_chars;
+            if (strings[0] != '\0' || strings[n_chars - 1] != '\0') return false;
+
+            for (const nuclide_record& x : nuclides)
+                if (x.name >= n_chars || x.half_life >= n_chars || (uint64_t)x.first_event + x.n_events > n_events) return false;
+            for (uint32_t i = 0; i < n_events; i++)
+            {
+                const event_record& e = events_[i];
+                if (e.type >= n_chars || e.target >= n_chars || e.branching_ratio >= n_chars ||
+                    (uint64_t)e.first_product + e.n_products > n_products) return false;
+            }
+            for (uint32_t i = 0; i < n_products; i++)
+                if (products_[i].name >= n_chars || products_[i].yield >= n_chars) return false;
+            return true;
+        }
+
+        /*
+            CHUNK
+            The records of a run of consecutive nuclide nodes, built by one thread. Its string
+            fields are local string IDs, i.e. 1 + the position in strings, 0 for the empty string.
+            The events and products are indexed from the start of the chunk.
+        */
+        struct chunk
+        {
+            vector<nuclide_record> nuclides;
+            vector<event_record> events;
+            vector<product_record> products;
+            vector<string_view> strings;                // They view the text of the source.
+            unordered_map<string_view, uint32_t> ids;
+
+            uint32_t intern(string_view s)
+            {
+                if (s.empty()) return 0;
+                auto it = ids.find(s);
+                if (it != ids.end()) return it->second;
+                strings.push_back(s);
+                ids.emplace(s, (uint32_t)strings.size());
+                return (uint32_t)strings.size();
+            }
+        };
+
+        /*
+            LOAD_XML
+            Builds the records from the parsed XML nuclides data file, src. If tracked is given,
+            only the nuclides and the fission products named in tracked are kept, in file order,
+            and the other fission products are skipped without being stored.
+
+            The nuclide nodes are split into chunks built in parallel. The chunks are then merged
+            in file order: their strings are interned into the string table in order of first
+            occurrence and their records are rebased. Hence, the library is the same for any
+            number of threads, each distinct string being stored once.
+        */
+        bool load_xml(const xml_source& src, const unordered_set<string_view>* tracked)
+        {
+            const int n_nodes = (int)src.nodes.size();
+            const int chunk_size = 64;
+            const int n_chunks = (n_nodes + chunk_size - 1) / chunk_size;
+            vector<chunk> chunks(n_chunks);
+
+            const mpfr_prec_t prec = mpreal::get_default_prec();
+            parallel_for(0, n_chunks, [&](int c)
+                {
+                    mpreal::set_default_prec(prec);
+                    const int last = min(n_nodes, (c + 1) * chunk_size);
+                    for (int i = c * chunk_size; i < last; i++)
+                        load_nuclide(src.nodes[i], chunks[c], tracked);
+                });
+
+//..........Interns the strings of every chunk, in order, and maps its local IDs to offsets.
+            unordered_map<string_view, uint32_t> interned;
+            vector<vector<uint32_t>> offsets(n_chunks);
+            vector<uint32_t> event_base(n_chunks + 1, 0), product_base(n_chunks + 1, 0), nuclide_base(n_chunks + 1, 0);
+            string_v.push_back('\0');
+            for (int c = 0; c < n_chunks; c++)
+            {
+                offsets[c].push_back(0);
+                for (string_view s : chunks[c].strings)
+                {
+                    auto it = interned.find(s);
+                    if (it == interned.end())
+                    {
+                        it = interned.emplace(s, (uint32_t)string_v.size()).first;
+                        string_v.insert(string_v.end(), s.begin(), s.end());
+                        string_v.push_back('\0');
+                    }
+                    offsets[c].push_back(it->second);
+                }
+                nuclide_base[c + 1] = nuclide_base[c] + (uint32_t)chunks[c].nuclides.size();
+                event_base[c + 1] = event_base[c] + (uint32_t)chunks[c].events.size();
+                product_base[c + 1] = product_base[c] + (uint32_t)chunks[c].products.size();
+            }
+
+//..........Rebases the records of every chunk into the library.
+            nuclide_v.resize(nuclide_base[n_chunks]);
+            event_v.resize(event_base[n_chunks]);
+            product_v.resize(product_base[n_chunks]);
+            parallel_for(0, n_chunks, [&](int c)
+                {
+                    const vector<uint32_t>& off = offsets[c];
+                    for (size_t k = 0; k < chunks[c].nuclides.size(); k++)
+                    {
+                        nuclide_record x = chunks[c].nuclides[k];
+                        x.name = off[x.name];
+                        x.half_life = off[x.half_life];
+                        x.first_event += event_base[c];
+                        nuclide_v[nuclide_base[c] + k] = x;
+                    }
+                    for (size_t k = 0; k < chunks[c].events.size(); k++)
+                    {
+                        event_record e = chunks[c].events[k];
+                        e.type = off[e.type];
+                        e.target = off[e.target];
+                        e.branching_ratio = off[e.branching_ratio];
+                        e.first_product += product_base[c];
+                        event_v[event_base[c] + k] = e;
+                    }
+                    for (size_t k = 0; k < chunks[c].products.size(); k++)
+                    {
+                        product_record r = chunks[c].products[k];
+                        product_v[product_base[c] + k] = { off[r.name], off[r.yield] };
+                    }
+                });
+
+            nuclides = { nuclide_v.data(), nuclide_v.size() };
+            events_ = event_v.data();
+            products_ = product_v.data();
+            strings = string_v.data();
+            n_events = (uint32_t)event_v.size();
+            n_products = (uint32_t)product_v.size();
+            n_chars = (uint32_t)string_v.size();
+            return true;
+        }
+
+//......Appends the records of the nuclide node, species, to the chunk, c, unless it is not tracked.
+        static void load_nuclide(xml_node species, chunk& c, const unordered_set<string_view>* tracked)
+        {
+            if (tracked && !tracked->count(species.attribute("name").value()))
+                return;
+
+            nuclide_record x;
+            x.name = c.intern(species.attribute("name").value());
+            x.half_life = c.intern(species.attribute("half_life").value());
+            x.first_event = (uint32_t)c.events.size();
+
+            for (xml_node removal : species.children())
+            {
+                string kind = removal.name();
+                event_record e = { 0, 0, 0, 0, (uint32_t)c.products.size(), 0 };
+                if (kind == "decay_type")
+                {
+                    e.kind = EVENT_DECAY;
+                    e.type = c.intern(removal.attribute("type").value());
+                    e.target = c.intern(removal.attribute("target").value());
+                    e.branching_ratio = c.intern(removal.attribute("branching_ratio").value());
+                    c.events.push_back(e);
+                }
+                else if (kind == "reaction_type" && removal.attribute("target"))
+                {
+                    e.kind = EVENT_REACTION;
+                    e.type = c.intern(removal.attribute("type").value());
+                    e.target = c.intern(removal.attribute("target").value());
+                    c.events.push_back(e);
+                }
+                else if (kind == "neutron_fission_yields")
+                    load_fission_yields(removal, c, tracked);
+            }
+
+            x.n_events = (uint32_t)c.events.size() - x.first_event;
+            c.nuclides.push_back(x);
+        }
+
+//......Keeps the yields tabulated at the first energy listed in <energies>. The product and the
+//      yield lists are walked in step, token by token.
+        static void load_fission_yields(xml_node removal, chunk& c, const unordered_set<string_view>* tracked)
+        {
+            mpreal energy = mpreal("0");
+            for (xml_node data : removal.children())
+            {
+                if (string(data.name()) == "energies")
+                {
+                    const char* p = data.child_value();
+                    string_view first = next_token(p);
+                    if (!first.empty()) energy = mpreal(string(first));
+                }
+
+                if (string(data.name()) == "fission_yields" && mpreal(data.attribute("energy").value()) == energy)
+                {
+                    event_record e = { EVENT_FISSION, c.intern("fission"), 0, 0, (uint32_t)c.products.size(), 0 };
+                    const char* p = data.child("products").child_value();
+                    const char* y = data.child("data").child_value();
+                    for (string_view product = next_token(p); !product.empty(); product = next_token(p))
+                    {
+                        string_view yield = next_token(y);
+                        if (yield.empty())
+                        {
+                            cout << "fatal-error <cnuctran.nuclide_library.load_fission_yields(...)>\nThe fission yields of "
+                                 << removal.parent().attribute("name").value() << " are fewer than its products." << endl;
+                            exit(1);
+                        }
+                        if (!tracked || tracked->count(product))
+                            c.products.push_back({ c.intern(product), c.intern(yield) });
+                    }
+                    e.n_products = (uint32_t)c.products.size() - e.first_product;
+                    c.events.push_back(e);
+                }
+            }
+        }
+
+//......Returns the next whitespace separated token of s and moves s past it, empty at the end.
+        static string_view next_token(const char*& s)
+        {
+            while (*s && isspace((unsigned char)*s)) s++;
+            const char* b = s;
+            while (*s && !isspace((unsigned char)*s)) s++;
+            return string_view(b, s - b);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,255 @@
+/*
+
+      This file is part of the CNUCTRAN library
+
+      @author   M. R. Omar (rabieomar@usm.my)
+      @license  MIT
+      @link     https://github.com/rabieomar92/cnuctran
+
+      Copyright (c) 2023, Universiti Sains Malaysia
+
+      This header file contains the definitions of SCALAR traits. SMATRIX, CSRMATRIX and
+      SOLVER are templated on the floating-point type of the calculation. SCALAR gathers
+      the few operations these classes need from the type, i.e. the conversions from and
+      to mpreal (the type of all input and output values), the exponential functions and
+      the kernel primitives of the sparse matrix multiplication.
+
+      Supported types are mpreal (arbitrary precision, the default), double, long double,
+      __float128 (if the compiler provides it), dd_real and qd_real (see ddreal.h) and
+      fpreal<N> (see fpreal.h). The fixed-point fxreal<F> (see fxreal.h) is only used for the
+      squaring of the transfer matrix, hence it provides the conversions and the kernel
+      primitives only.
+
+ */
+
+#ifndef SCALAR_H
+#define SCALAR_H
+
+#include <mpreal.h>
+#include <ddreal.h>
+#include <fpreal.h>
+#include <fxreal.h>
+#include <cmath>
+#include <limits>
+#include <string>
+
+#if defined(__SIZEOF_FLOAT128__) && !defined(CNUCTRAN_HAVE_FLOAT128)
+#define CNUCTRAN_HAVE_FLOAT128
+#endif
+
+using namespace mpfr;
+
+namespace cnuctran
+{
+
+    template <typename real> struct scalar;
+
+    template <> struct scalar<mpreal>
+    {
+        static const char* name(void) { return "mpreal"; }
+        static int digits(void) { return bits2digits(mpreal::get_default_prec()); }
+
+        static mpreal from_mpreal(const mpreal& x) { return x; }
+        static mpreal to_mpreal(const mpreal& x) { return x; }
+        static mpreal zero(mpfr_prec_t bits) { return mpreal(0, bits); }
+        static mpreal exp(const mpreal& x) { return mpfr::exp(x); }
+        static mpreal expm1(const mpreal& x) { return mpfr::expm1(x); }
+
+        // Kernel primitives. tmp is a scratch operand owned by the calling thread.
+        static void prepare(mpreal& tmp, mpfr_prec_t bits) { if (tmp.get_prec() != bits) tmp.set_prec(bits); }
+        static void set_zero(mpreal& x) { mpfr_set_zero(x.mpfr_ptr(), 1); }
+        static void assign(mpreal& dst, const mpreal& src) { mpfr_set(dst.mpfr_ptr(), src.mpfr_srcptr(), MPFR_RNDN); }
+
+        // Computes c += a * b through the scratch operand tmp, i.e. without creating a
+        // temporary mpreal for the product. The rounding is the same as c += a * b.
+        static void fma_acc(mpreal& c, const mpreal& a, const mpreal& b, mpreal& tmp)
+        {
+            mpfr_mul(tmp.mpfr_ptr(), a.mpfr_srcptr(), b.mpfr_srcptr(), MPFR_RNDN);
+            mpfr_add(c.mpfr_ptr(), c.mpfr_srcptr(), tmp.mpfr_srcptr(), MPFR_RNDN);
+        }
+    };
+
+    // Common definitions of the hardware floating-point types.
+    template <typename real> struct scalar_builtin
+    {
+        static int digits(void) { return std::numeric_limits<real>::digits10; }
+        static real zero(mpfr_prec_t) { return real(0); }
+        static void prepare(real&, mpfr_prec_t) { return; }
+        static void set_zero(real& x) { x = real(0); }
+        static void assign(real& dst, const real& src) { dst = src; }
+        static void fma_acc(real& c, const real& a, const real& b, real&) { c += a * b; }
+    };
+
+    template <> struct scalar<double> : scalar_builtin<double>
+    {
+        static const char* name(void) { return "double"; }
+        static double from_mpreal(const mpreal& x) { return x.toDouble(); }
+        static mpreal to_mpreal(const double& x) { return mpreal(x); }
+        static double exp(const double& x) { return std::exp(x); }
+        static double expm1(const double& x) { return std::expm1(x); }
+    };
+
+    template <> struct scalar<long double> : scalar_builtin<long double>
+    {
+        static const char* name(void) { return "long double"; }
+        static long double from_mpreal(const mpreal& x) { return x.toLDouble(); }
+        static mpreal to_mpreal(const long double& x) { return mpreal(x); }
+        static long double exp(const long double& x) { return std::exp(x); }
+        static long double expm1(const long double& x) { return std::expm1(x); }
+    };
+
+#ifdef CNUCTRAN_HAVE_FLOAT128
+    // __float128 is converted through a sum of three doubles, which covers its 113-bit
+    // significand. The exponential goes through mpreal since it is only needed while
+    // building the transfer matrix.
+    template <> struct scalar<__float128> : scalar_builtin<__float128>
+    {
+        static const char* name(void) { return "float128"; }
+        static int digits(void) { return 33; }
+
+        static __float128 from_mpreal(const mpreal& x)
+        {
+            mpreal r = x;
+            double hi = r.toDouble(); r -= hi;
+            double mi = r.toDouble(); r -= mi;
+            double lo = r.toDouble();
+            return (__float128)hi + (__float128)mi + (__float128)lo;
+        }
+
+        static mpreal to_mpreal(const __float128& x)
+        {
+            double hi = (double)x;
+            double mi = (double)(x - hi);
+            double lo = (double)(x - hi - mi);
+            mpreal r = mpreal(hi, mpreal::get_default_prec() > 128 ? mpreal::get_default_prec() : 128);
+            r += mi; r += lo;
+            return r;
+        }
+
+        static __float128 exp(const __float128& x) { return from_mpreal(mpfr::exp(to_mpreal(x))); }
+        static __float128 expm1(const __float128& x) { return from_mpreal(mpfr::expm1(to_mpreal(x))); }
+    };
+#endif
+
+    // The double-double and quad-double types are converted component by component. Their
+    // exponential goes through mpreal at 128 and 256 bits, respectively.
+    template <typename real, int n, int bits> struct scalar_multi_double : scalar_builtin<real>
+    {
+        static real from_mpreal(const mpreal& x)
+        {
+            mpreal r = x;
+            real y;
+            for (int i = 0; i < n; i++)
+            {
+                y.x[i] = r.toDouble();
+                r -= y.x[i];
+            }
+            return y;
+        }
+
+        static mpreal to_mpreal(const real& x)
+        {
+            mpfr_prec_t prec = mpreal::get_default_prec() > bits ? mpreal::get_default_prec() : bits;
+            mpreal r = mpreal(x.x[0], prec);
+            for (int i = 1; i < n; i++)
+                r += x.x[i];
+            return r;
+        }
+
+        static real exp(const real& x) { return from_mpreal(mpfr::exp(to_mpreal(x))); }
+        static real expm1(const real& x) { return from_mpreal(mpfr::expm1(to_mpreal(x))); }
+    };
+
+    template <> struct scalar<dd_real> : scalar_multi_double<dd_real, 2, 128>
+    {
+        static const char* name(void) { return "double-double"; }
+        static int digits(void) { return 31; }
+    };
+
+    template <> struct scalar<qd_real> : scalar_multi_double<qd_real, 4, 256>
+    {
+        static const char* name(void) { return "quad-double"; }
+        static int digits(void) { return 62; }
+    };
+
+    // FPREAL<N> runs the kernel on its own mpn arithmetic. The conversions and the exponential
+    // go through MPFR on a view of the inline significand.
+    template <int N> struct scalar<fpreal<N>> : scalar_builtin<fpreal<N>>
+    {
+        typedef typename fpreal<N>::view view;
+
+        static const char* name(void)
+        {
+            static const std::string s = "fpreal-" + std::to_string(fpreal<N>::bits);
+            return s.c_str();
+        }
+        static int digits(void) { return bits2digits(fpreal<N>::bits); }
+
+        static fpreal<N> from_mpreal(const mpreal& x)
+        {
+            fpreal<N> y;
+            view v(y);
+            mpfr_set(v.x, x.mpfr_srcptr(), MPFR_RNDN);
+            v.store();
+            return y;
+        }
+
+        static mpreal to_mpreal(const fpreal<N>& x)
+        {
+            mpreal r = mpreal(0, mpreal::get_default_prec() > fpreal<N>::bits ? mpreal::get_default_prec() : fpreal<N>::bits);
+            mpfr_set(r.mpfr_ptr(), view(x).x, MPFR_RNDN);
+            return r;
+        }
+
+        static fpreal<N> exp(const fpreal<N>& x)
+        {
+            fpreal<N> y;
+            view v(y);
+            mpfr_exp(v.x, view(x).x, MPFR_RNDN);
+            v.store();
+            return y;
+        }
+
+        static fpreal<N> expm1(const fpreal<N>& x)
+        {
+            fpreal<N> y;
+            view v(y);
+            mpfr_expm1(v.x, view(x).x, MPFR_RNDN);
+            v.store();
+            return y;
+        }
+
+        static void set_zero(fpreal<N>& x) { x.s = 0; }
+        static void fma_acc(fpreal<N>& c, const fpreal<N>& a, const fpreal<N>& b, fpreal<N>& tmp)
+        {
+            fpreal<N>::mul(tmp, a, b);
+            fpreal<N>::add(c, c, tmp);
+        }
+    };
+
+    template <int F> struct scalar<fxreal<F>>
+    {
+        static const char* name(void)
+        {
+            static const std::string s = "fixed-point-" + std::to_string(fxreal<F>::frac_bits);
+            return s.c_str();
+        }
+        static int digits(void) { return bits2digits(fxreal<F>::frac_bits); }
+
+        static fxreal<F> from_mpreal(const mpreal& x) { return fxreal<F>::from_mpreal(x); }
+        static mpreal to_mpreal(const fxreal<F>& x)
+        {
+            const mpfr_prec_t bits = fxreal<F>::limbs * GMP_NUMB_BITS;
+            return fxreal<F>::to_mpreal(x, mpreal::get_default_prec() > bits ? mpreal::get_default_prec() : bits);
+        }
+        static fxreal<F> zero(mpfr_prec_t) { return fxreal<F>(); }
+
+        static void prepare(fxreal<F>&, mpfr_prec_t) { return; }
+        static void set_zero(fxreal<F>& x) { x = fxreal<F>(); }
+        static void assign(fxreal<F>& dst, const fxreal<F>& src) { dst = src; }
+        static void fma_acc(fxreal<F>& c, const fxreal<F>& a, const fxreal<F>& b, fxreal<F>&) { fxreal<F>::fma_acc(c, a, b); }
+    };
+
+}
+
+#endif
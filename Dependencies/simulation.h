@@ -20,6 +20,7 @@
 #include <fstream>
 #include <pugixml.hpp>
 #include <solver.h>
+#include <nuclides.h>
 
 using namespace pugi;
 using namespace mpfr;
@@ -34,166 +35,85 @@ namespace cnuctran {
     public:
 
         /*
-            This sub-routine reads nuclide transmutation information from the XML 
-            nuclides data library.
+            This sub-routine defines the removal events of the solver species from the nuclides
+            data library, see nuclides.h. The species are looked up through a local name index.
+            rxn_rates holds the reaction rates of each species ID, keyed by reaction type.
 
         */
-        static void build_chains(solver& s, map<string, map<string, mpreal>>& rxn_rates,
+        template <typename real>
+        static void build_chains(solver<real>& s, const vector<map<string, mpreal>>& rxn_rates,
             string xml_data_location)
         {
-            vector<string> species_names = s.species_names;
-
-            //..........Loads the nuclides data from the XML source file. 
-            xml_document file;
-            xml_parse_result open_success = file.load_file(xml_data_location.c_str());
-            if (!open_success)
+            shared_ptr<const nuclide_library> library = nuclide_library::get(xml_data_location, s.species_names);
+            if (!library)
             {
                 cout << "INFO\t<cnuctran::depletion_scheme::build_chains(...)> Nuclides data file is not provided." << endl;
                 return;
             }
 
-            //..........Unpack the XML root.
-            xml_node root = file.child("depletion");
-
-            for (xml_node species : root.children())
-            {
-                string species_name = species.attribute("name").value();
-                vector<string>::iterator it = std::find(species_names.begin(), species_names.end(), species_name);
-                if (it == species_names.end())
-                    continue;
-
+            //..........Maps the species names to their ID, the first occurrence wins.
+            unordered_map<string_view, int> species_id;
+            for (int i = 0; i < (int)s.species_names.size(); i++)
+                species_id.emplace(s.species_names[i], i);
+            auto id_of = [&](uint32_t name) { auto it = species_id.find(library->str(name)); return it == species_id.end() ? __nop__ : it->second; };
+
+            //..........The removals of every tracked nuclide are converted to high precision by the worker
+            //          threads, then added to the solver in file order.
+            struct removal { int parent; mpreal rate; vector<int> products; vector<mpreal> yields; };
+            vector<const nuclide_record*> tracked;
+            for (const nuclide_record& x : library->nuclides)
+                if (id_of(x.name) != __nop__) tracked.push_back(&x);
+            vector<vector<removal>> removals(tracked.size());
+
+            const mpreal ln2 = mpfr::log(mpreal("2"));
+            const mpfr_prec_t prec = mpreal::get_default_prec();
+            parallel_for(0, (int)tracked.size(), [&](int k)
+                {
+                    mpreal::set_default_prec(prec);
+                    const nuclide_record& x = *tracked[k];
+                    const int parent_id = id_of(x.name);
 
-                mpreal decay_rate;
-                if (species.attribute("half_life"))
-                    decay_rate = mpfr::log(mpreal("2")) / mpreal(species.attribute("half_life").value());
-                else
-                    decay_rate = mpreal("0");
+                    const char* half_life = library->str(x.half_life);
+                    const mpreal decay_rate = *half_life == '\0' ? mpreal("0") : ln2 / mpreal(half_life);
 
-                for (xml_node removal : species.children())
-                {
-                    if (string(removal.name()) == "decay_type")
+                    const map<string, mpreal>& rates = rxn_rates[parent_id];
+                    for (const event_record& e : library->events(x))
                     {
-                        mpreal decay_rate_adjusted = mpreal(removal.attribute("branching_ratio").value()) * decay_rate;
-                        string parent = species_name;
-                        string daughter = removal.attribute("target").value();
-                        vector<string>::iterator it_parent = std::find(species_names.begin(), species_names.end(), parent);
-                        int parent_id = distance(species_names.begin(), it_parent);
-                        vector<string>::iterator it_daughter = std::find(species_names.begin(), species_names.end(), daughter);
-                        if (it_daughter != species_names.end())
-                        {
-                            int daughter_id = distance(species_names.begin(), it_daughter);
-                            s.add_removal(parent_id, decay_rate_adjusted, vector<int>({ daughter_id }));
-                        }
-                        else
-                        {
-                            s.add_removal(parent_id, decay_rate_adjusted, vector<int>({ __nop__ }));
-                        }
+                        if (e.kind == EVENT_DECAY)
+                            removals[k].push_back({ parent_id, mpreal(library->str(e.branching_ratio)) * decay_rate, vector<int>({ id_of(e.target) }), {} });
 
-                    }
+                        if (rates.empty())
+                            continue;
 
-                    if (rxn_rates.size() != 0)
-                    {
-                        if (rxn_rates.count(species_name))
-                        {
-                            if (string(removal.name()) == "reaction_type" && removal.attribute("target"))
-                            {
-                                string parent = species_name;
-                                vector<string>::iterator it_parent = std::find(species_names.begin(), species_names.end(), parent);
-                                int parent_id = distance(species_names.begin(), it_parent);
-                                if (rxn_rates[parent].count(removal.attribute("type").value()) &&
-                                    removal.attribute("type").value() != "fission")
-                                {
-                                    string daughter = removal.attribute("target").value();
-                                    mpreal removal_rate = mpreal(rxn_rates[parent][removal.attribute("type").value()]);
-                                    vector<string>::iterator it_daughter = std::find(species_names.begin(), species_names.end(), daughter);
-                                    if (it_daughter != species_names.end())
-                                    {
-                                        int daughter_id = distance(species_names.begin(), it_daughter);
-                                        s.add_removal(parent_id, removal_rate, vector<int>({ daughter_id }));
-                                    }
-                                    else
-                                    {
-                                        s.add_removal(parent_id, removal_rate, vector<int>({ __nop__ }));
-                                    }
-                                }
-                            }
+                        auto rate = rates.find(library->str(e.type));
+                        if (e.kind == EVENT_REACTION && rate != rates.end())
+                            removals[k].push_back({ parent_id, mpreal(rate->second), vector<int>({ id_of(e.target) }), {} });
 
-                            if (string(removal.name()) == "neutron_fission_yields")
+                        if (e.kind == EVENT_FISSION && rate != rates.end())
+                        {
+                            //..........................Keeps the products tracked by the solver, with the yield of their first
+                            //                          occurrence in the products list. Equal names share one string offset.
+                            unordered_map<uint32_t, uint32_t> first_yield;
+                            for (const product_record& product : library->products(e))
+                                first_yield.emplace(product.name, product.yield);
+                            removal r = { parent_id, rate->second, {}, {} };
+                            for (const product_record& product : library->products(e))
                             {
-                                string parent = species_name;
-                                vector<string>::iterator it_parent = std::find(species_names.begin(), species_names.end(), parent);
-                                int parent_id = distance(species_names.begin(), it_parent);
-                                mpreal energy = mpreal("0");
-                                vector<string> products;
-                                vector<mpreal> yields;
-                                if (rxn_rates[parent].count("fission") != 0)
+                                int product_id = id_of(product.name);
+                                if (product_id != __nop__)
                                 {
-                                    for (xml_node data : removal.children())
-                                    {
-                                        if (string(data.name()) == "energies")
-                                        {
-                                            stringstream ss(data.child_value()); string token;
-                                            vector<string> energies;
-                                            while (getline(ss, token, ' '))
-                                                if (token != "")
-                                                    energies.push_back(token);
-                                            energy = energies[0];
-                                        }
-
-                                        if (string(data.name()) == "fission_yields")
-                                        {
-                                            if (mpreal(data.attribute("energy").value()) == energy)
-                                            {
-                                                for (xml_node param : data.children())
-                                                {
-                                                    if (string(param.name()) == "products")
-                                                    {
-                                                        stringstream ss(param.child_value()); string token;
-                                                        while (getline(ss, token, ' '))
-                                                            if (token != "")
-                                                                products.push_back(token);
-                                                    }
-
-                                                    if (string(param.name()) == "data")
-                                                    {
-                                                        stringstream ss(param.child_value()); string token;
-                                                        while (getline(ss, token, ' '))
-                                                            if (token != "")
-                                                                yields.push_back(mpreal(token));
-                                                    }
-
-                                                }
-
-                                                mpreal total_fission_rate = rxn_rates[parent]["fission"];
-                                                vector<mpreal> yields_to_add;
-                                                vector<int> daughters_id_to_add;
-                                                vector<string>::iterator it_product;
-                                                for (string product : products)
-                                                {
-
-                                                    it_product = find(species_names.begin(), species_names.end(), product);
-                                                    if (it_product != species_names.end())
-                                                    {
-                                                        int product_id = distance(species_names.begin(), it_product);
-                                                        daughters_id_to_add.push_back(product_id);
-                                                        it_product = find(products.begin(), products.end(), product);
-                                                        product_id = distance(products.begin(), it_product);
-                                                        yields_to_add.push_back(yields[product_id]);
-                                                    }
-                                                }
-                                                it_parent = find(species_names.begin(), species_names.end(), parent);
-                                                parent_id = distance(species_names.begin(), it_parent);
-
-                                                s.add_removal(parent_id, total_fission_rate, daughters_id_to_add, yields_to_add);
-                                            }
-                                        }
-                                    }
+                                    r.products.push_back(product_id);
+                                    r.yields.push_back(mpreal(library->str(first_yield[product.name])));
                                 }
                             }
+                            removals[k].push_back(r);
                         }
                     }
-                }
-            }
+                });
+
+            for (vector<removal>& rs : removals)
+                for (removal& r : rs)
+                    s.add_removal(r.parent, r.rate, r.products, r.yields);
 
             return;
         }
@@ -204,32 +124,27 @@ namespace cnuctran {
         //xml_data_location = the location of the nuclides data file.
         static vector<string> get_nuclide_names(string xml_data_location, int AMin = -1, int AMax = -1)
         {
-            xml_document file;
-            xml_parse_result open_success = file.load_file(xml_data_location.c_str());
-            if (!open_success)
+            vector<string> names = nuclide_library::names(xml_data_location);
+            if (names.empty())
             {
                 cout << "ERROR <cnuctran.depletion_scheme.get_nuclide_names(...)>\nFail retrieving data from " << xml_data_location << "." << endl;
                 return vector<string>();
             }
 
-
-            xml_node root = file.child("depletion");
-
             vector<string> species_names;
 
-            for (xml_node species : root.children())
+            for (const string& name : names)
             {
-                string name = species.attribute("name").value();
                 stringstream ss(name); string token;
                 getline(ss, token, '_');
-                string x = "";
+                string x_digits = "";
                 for (char c : token)
-                    if (isdigit(c)) x += c;
+                    if (isdigit(c)) x_digits += c;
                 if (AMin == AMax == -1)
                     species_names.push_back(name);
                 else
                 {
-                    int A = stoi(x);
+                    int A = stoi(x_digits);
                     if (A >= AMin && A <= AMax)
                         species_names.push_back(name);
                 }
@@ -238,6 +153,144 @@ namespace cnuctran {
         }
 
 
+        /*
+            Builds the chains of the zone and solves the final nuclides concentrations using the
+            floating-point type, real. The species not solved for the targets are flagged in pruned, the
+            species whose initial concentrations are unknown are flagged in unknown, see solver::solve.
+        */
+        template <typename real>
+        static vector<mpreal> solve_zone(const vector<string>& species_names,
+            const vector<map<string, mpreal>>& rxn_rates,
+            string xml_data_location,
+            const vector<mpreal>& w0,
+            const vector<int>& targets,
+            const vector<char>& unknown,
+            vector<char>& pruned,
+            mpreal n,
+            mpreal t,
+            string& type_name,
+            int& type_digits)
+        {
+            type_name = scalar<real>::name();
+            type_digits = scalar<real>::digits();
+            solver<real> sol = solver<real>(species_names);
+            build_chains(sol, rxn_rates, xml_data_location);
+            if (__vbs__) mpalloc::report("input and chains");
+            return sol.solve(w0, n, t, targets, unknown, pruned);
+        }
+
+        /*
+            ESTIMATE_DIGITS
+            Estimates the precision digits needed to reproduce output_digits significant digits. The
+            pi-distribution is free of cancellation (see solver::prepare_transfer_matrix), hence the
+            loss comes from the k squarings, which amplify the rounding errors of the entries close to
+            one by up to 2^k.
+        */
+        static int estimate_digits(mpreal n, mpreal t, int output_digits)
+        {
+            int k = int(floor(log(t / pow(mpreal("10"), -n)) / log(mpreal("2.0"))));
+            int growth = (int)ceil(k * log10(2.0));
+            int digits = output_digits + growth + 5;
+            if (__vbs__) cout << "Estimated precision: " << digits << " digits (" << output_digits << " output, "
+                              << growth << " lost over " << k << " squarings, 5 guard)." << endl;
+            return digits < 30 ? 30 : digits;
+        }
+
+        /*
+            Solves the zone with the automatic precision. The chains are built once at max_digits,
+            the probe solves the zone at the estimated precision, p, and at p + 10 digits. If both
+            agree to output_digits, the latter is returned. Otherwise, p grows by half and the probe
+            is repeated, up to max_digits. The probe costs two full solves, and so does every raise,
+            unless the new p equals the previous p + 10 digits, whose solution is then reused.
+        */
+        static vector<mpreal> solve_zone_auto(const vector<string>& species_names,
+            const vector<map<string, mpreal>>& rxn_rates,
+            string xml_data_location,
+            const vector<mpreal>& w0,
+            const vector<int>& targets,
+            const vector<char>& unknown,
+            vector<char>& pruned,
+            mpreal n,
+            mpreal t,
+            int output_digits,
+            int max_digits,
+            string& type_name,
+            int& type_digits)
+        {
+            const int guard = 10;
+            mpreal::set_default_prec(digits2bits(max_digits));
+            __dps__ = max_digits;
+            solver<mpreal> master = solver<mpreal>(species_names);
+            build_chains(master, rxn_rates, xml_data_location);
+            if (__vbs__) mpalloc::report("input and chains");
+
+            const int estimate = estimate_digits(n, t, output_digits);
+            int p = estimate < max_digits - guard ? estimate : max_digits - guard;
+            vector<mpreal> w;
+            int w_digits = 0;
+            while (true)
+            {
+                vector<mpreal> w_p = w_digits == p ? w : solve_at(master, w0, targets, unknown, pruned, n, t, p);
+                w = solve_at(master, w0, targets, unknown, pruned, n, t, p + guard);
+                w_digits = p + guard;
+                const mpreal tol = pow(mpreal(10), -output_digits);
+                mpreal worst = 0;
+                for (size_t i = 0; i < w.size(); i++)
+                    if (w[i] != 0 && abs(w_p[i] - w[i]) > worst * abs(w[i]))
+                        worst = abs(w_p[i] - w[i]) / abs(w[i]);
+                const bool agree = worst <= tol;
+                if (__vbs__) cout << "Precision probe at " << p << " and " << p + guard << " digits: "
+                                  << (agree ? "agree" : "disagree") << ", largest relative difference "
+                                  << worst.toString(3) << "." << endl;
+                if (agree) break;
+                if (p + guard >= max_digits)
+                {
+                    cout << "warning <cnuctran.simulation.solve_zone_auto()>\nThe precision probe did not converge up to "
+                         << max_digits << " digits." << endl;
+                    break;
+                }
+                p = p + p / 2 < max_digits - guard ? p + p / 2 : max_digits - guard;
+            }
+
+            type_digits = p + guard;
+            type_name = string(scalar<mpreal>::name()) + ", auto from an estimate of " + to_string(estimate) + " digits";
+            mpreal::set_default_prec(digits2bits(max_digits));
+            __dps__ = max_digits;
+            return w;
+        }
+
+        // Solves the zone at the given precision digits. The rates, the yields and the inputs of the
+        // master solver are rounded to that precision.
+        static vector<mpreal> solve_at(const solver<mpreal>& master,
+            const vector<mpreal>& w0,
+            const vector<int>& targets,
+            const vector<char>& unknown,
+            vector<char>& pruned,
+            mpreal n,
+            mpreal t,
+            int digits)
+        {
+            const mpfr_prec_t bits = digits2bits(digits);
+            mpreal::set_default_prec(bits);
+            __dps__ = digits;
+            if (mpalloc::is_installed()) mpalloc::install(bits);
+            auto rounded = [bits](mpreal x) { x.set_prec(bits); return x; };
+
+            solver<mpreal> sol = solver<mpreal>(master.species_names);
+            sol.G = master.G;
+            sol.lambdas = master.lambdas;
+            sol.fission_yields = master.fission_yields;
+            for (vector<mpreal>& rates : sol.lambdas)
+                for (mpreal& rate : rates) rate = rounded(rate);
+            for (vector<mpreal>& yields : sol.fission_yields)
+                for (mpreal& yield : yields) yield = rounded(yield);
+
+            vector<mpreal> w0_rounded;
+            for (const mpreal& c : w0)
+                w0_rounded.push_back(rounded(c));
+            return sol.solve(w0_rounded, rounded(n), rounded(t), targets, unknown, pruned);
+        }
+
         /*
             Reads the input XML file (input.xml) and obtains all simulation parameters. Finally, this
             routine runs the simulation.
@@ -274,17 +327,64 @@ namespace cnuctran {
                 tmp = root.child("simulation_params").child("verbosity").child_value();
                 tmp != "" ? __vbs__ = stoi(tmp) : __vbs__ = 0;
 
-                //Obtains the precision digits from the input file.
+                //Obtains the floating-point type of the calculation from the input file, i.e. mpreal (default),
+                //double, long_double, float128, dd, qd, fpreal or auto. The fpreal type selects the smallest
+                //fixed-precision fpreal<N> covering the precision digits. The auto type selects double-double if
+                //it covers the precision digits, fpreal otherwise.
+                tmp = root.child("simulation_params").child("scalar_type").child_value();
+                if (string(tmp) == "double") __typ__ = STYPE_DOUBLE;
+                else if (string(tmp) == "dd") __typ__ = STYPE_DD;
+                else if (string(tmp) == "qd") __typ__ = STYPE_QD;
+                else if (string(tmp) == "auto") __typ__ = STYPE_AUTO;
+                else if (string(tmp) == "fpreal") __typ__ = STYPE_FPREAL;
+                else if (string(tmp) == "long_double") __typ__ = STYPE_LONG_DOUBLE;
+#ifdef CNUCTRAN_HAVE_FLOAT128
+                else if (string(tmp) == "float128") __typ__ = STYPE_FLOAT128;
+#endif
+                else if (string(tmp) == "mpreal") __typ__ = STYPE_MPREAL;
+                else if (string(tmp) != "")
+                    cout << "warning <cnuctran.simulation.from_input()>\nUnsupported scalar type '" << tmp << "'. The mpreal type is used." << endl;
+
+                //Obtains the precision digits from the input file. With auto, the input is read at the maximum
+                //precision, precision_digits, and the precision of every zone is selected by solve_zone_auto.
                 tmp = root.child("simulation_params").child("precision_digits").child_value();
-                if (tmp != "")
+                bool auto_precision = string(tmp) == "auto";
+                if (auto_precision && __typ__ != STYPE_MPREAL)
+                {
+                    auto_precision = false;
+                    precision_digits = __dps__;
+                    cout << "warning <cnuctran.simulation.from_input()>\nThe automatic precision requires the mpreal type. The precision was set to "
+                         << precision_digits << " digits." << endl;
+                }
+                else if (auto_precision)
+                    __dps__ = precision_digits;
+                else if (string(tmp) != "")
                 {
                     precision_digits = stoi(tmp);
                     __dps__ = precision_digits;
                 } 
                 else
                     precision_digits = __dps__;
+
+                if (__typ__ == STYPE_AUTO)
+                    __typ__ = precision_digits <= scalar<dd_real>::digits() ? STYPE_DD : STYPE_FPREAL;
+
+                if (__typ__ == STYPE_FPREAL)
+                {
+                    mpfr_prec_t bits = digits2bits(precision_digits);
+                    if (bits <= fpreal<2>::bits) __typ__ = STYPE_FP128;
+                    else if (bits <= fpreal<3>::bits) __typ__ = STYPE_FP192;
+                    else if (bits <= fpreal<4>::bits) __typ__ = STYPE_FP256;
+                    else if (bits <= fpreal<8>::bits) __typ__ = STYPE_FP512;
+                    else
+                    {
+                        __typ__ = STYPE_MPREAL;
+                        cout << "warning <cnuctran.simulation.from_input()>\nThe precision exceeds the widest fpreal type (" << fpreal<8>::bits
+                             << " bits). The mpreal type is used." << endl;
+                    }
+                }
               
-                if (precision_digits < 30)
+                if (precision_digits < 30 && __typ__ == STYPE_MPREAL)
                 {
                     precision_digits = 30;
                     cout << "warning <cnuctran.simulation.from_input()>\nA precision < 30 digits is vulnerable to errorneous arithmetics that lead to fatal error." << endl;
@@ -303,10 +403,62 @@ namespace cnuctran {
                 tmp = root.child("simulation_params").child("epsilon").child_value();
                 if (tmp != "") __eps__ = mpreal(tmp);
 
+                //Obtains the sparse matrix storage format from the input file, i.e. csr (default) or hash.
+                tmp = root.child("simulation_params").child("matrix_format").child_value();
+                if (string(tmp) == "hash") __fmt__ = MFORMAT_HASH;
+                else if (string(tmp) == "csr") __fmt__ = MFORMAT_CSR;
+                else if (string(tmp) != "")
+                    cout << "warning <cnuctran.simulation.from_input()>\nUnknown matrix format '" << tmp << "'. The csr format is used." << endl;
+
+                //Obtains the number of fractional bits of the fixed-point squaring, which is only available
+                //with the csr format.
+                tmp = root.child("simulation_params").child("fixed_point_bits").child_value();
+                string(tmp) != "" ? __fxb__ = stoi(tmp) : __fxb__ = 0;
+                if (__fxb__ > 0 && __fmt__ != MFORMAT_CSR)
+                {
+                    __fxb__ = 0;
+                    cout << "warning <cnuctran.simulation.from_input()>\nThe fixed-point squaring requires the csr format. It is disabled." << endl;
+                }
+                else if (__fxb__ > 8 * GMP_NUMB_BITS)
+                {
+                    __fxb__ = 8 * GMP_NUMB_BITS;
+                    cout << "warning <cnuctran.simulation.from_input()>\nThe fixed-point squaring supports at most " << __fxb__ << " fractional bits." << endl;
+                }
+
                 //Obtains the output precision digits from the input file.
                 tmp = root.child("simulation_params").child("output_digits").child_value();
                 tmp != "" ? output_digits = stoi(tmp) : output_digits = __dop__;
 
+                //Enables the mixed-precision squaring, which is checked against the output precision digits.
+                //It is only available with the csr format.
+                tmp = root.child("simulation_params").child("mixed_precision").child_value();
+                __mxp__ = string(tmp) == "true" ? output_digits : 0;
+                if (__mxp__ > 0 && __fmt__ != MFORMAT_CSR)
+                {
+                    __mxp__ = 0;
+                    cout << "warning <cnuctran.simulation.from_input()>\nThe mixed-precision squaring requires the csr format. It is disabled." << endl;
+                }
+
+                //Prunes the species unreachable from the initial composition, unless disabled.
+                tmp = root.child("simulation_params").child("prune").child_value();
+                __prn__ = string(tmp) == "false" ? 0 : 1;
+
+                //Obtains the half-life threshold, relative to the time step, of the species lumped into their parents.
+                tmp = root.child("simulation_params").child("lump_threshold").child_value();
+                string(tmp) != "" ? __lmp__ = stod(tmp) : __lmp__ = 0;
+
+                //Obtains the renumbering of the species, none by default.
+                tmp = root.child("simulation_params").child("renumber").child_value();
+                __rnb__ = RENUMBER_NONE;
+                if (string(tmp) == "topological") __rnb__ = RENUMBER_TOPOLOGICAL;
+                else if (string(tmp) == "rcm") __rnb__ = RENUMBER_RCM;
+                else if (string(tmp) != "" && string(tmp) != "none")
+                    cout << "warning <cnuctran.simulation.from_input()>\nUnknown renumbering '" << tmp << "'. The species are not renumbered." << endl;
+
+                //Installs the pooled allocator for the MPFR limbs if requested. With the automatic
+                //precision, the pool is resized to the working precision of every zone, see solve_at.
+                tmp = root.child("simulation_params").child("mp_arena").child_value();
+                if (string(tmp) == "true") mpalloc::install(digits2bits(precision_digits));
 
                 //IMPORTANT! Reads the precision before declaring any high-precision float vars.
                 mpreal::set_default_prec(digits2bits(precision_digits));
@@ -346,9 +498,7 @@ namespace cnuctran {
                     vector<string> species_names;
                     auto species = zone.child("species").child_value();
                     if (strlen(zone.child("species").attribute("amin").value()) > 0) {
-                        xml_document source;
-                        auto open_success = source.load_file(zone.child("species").attribute("source").value());
-                        if (open_success)
+                        if (!nuclide_library::names(zone.child("species").attribute("source").value()).empty())
                         {   
                             AMax = strlen(zone.child("species").attribute("amax").value()) > 0 ? stoi(zone.child("species").attribute("amax").value()) : 400;
                             AMin = strlen(zone.child("species").attribute("amin").value()) > 0 ? stoi(zone.child("species").attribute("amin").value()) : 0;
@@ -370,15 +520,17 @@ namespace cnuctran {
                         if (__vbs__) cout << "Building chains... Total no. of nuclides = " << species_names.size() << endl;
                     }
 
-//..................Reads the initial concentrations for each zone.
-                    map<string, mpreal> w0;
+//..................Reads the initial concentrations for each zone. They are kept by name until the
+//                  species list is final.
+                    vector<pair<string, mpreal>> w0_read;
+                    vector<string> w0_pruned;
                     const char* w0_source = zone.child("initial_concentrations").attribute("source").value();
                     const char* override_species_names = zone.child("initial_concentrations").attribute("override").value();
-                    if (w0_source != "")
+                    if (string(w0_source) != "")
                     {
                         xml_document w0_doc;
                         auto load_success = w0_doc.load_file(w0_source);
-                        if (override_species_names == "true") species_names.clear();
+                        if (string(override_species_names) == "true") species_names.clear();
                         if (load_success)
                         {
                             for (xml_node concs : w0_doc.child("output").children())
@@ -391,18 +543,23 @@ namespace cnuctran {
                                 {
                                     if (string(nuclide.name()) != "concentration") continue;
                                     auto name = nuclide.attribute("species").value();
+
+                                    // A pruned species has a population that was not computed, see PRUNED_W0.
+                                    if (string(nuclide.attribute("pruned").value()) == "true")
+                                    {
+                                        if (string(override_species_names) == "true") species_names.push_back(name);
+                                        w0_pruned.push_back(name);
+                                        continue;
+                                    }
                                     auto concentration = mpreal(nuclide.attribute("value").value());
-                                    if (override_species_names == "true")
+                                    if (string(override_species_names) == "true")
                                     {
                                         species_names.push_back(name);
                                         if (concentration != mpreal("0"))
-                                            w0[name] = concentration;
+                                            w0_read.push_back({ name, concentration });
                                     }
                                     else
-                                    {
-                                        if (find(species_names.begin(), species_names.end(), name) != species_names.end())
-                                            w0[name] = concentration;
-                                    }
+                                        w0_read.push_back({ name, concentration });
                                 }
                             }
                         }
@@ -419,23 +576,117 @@ namespace cnuctran {
                         {
                             if (string(item.name()) != "concentration") continue;
                             mpreal concentration = mpreal(item.attribute("value").value());
-                            w0[item.attribute("species").value()] = concentration;
+                            w0_read.push_back({ item.attribute("species").value(), concentration });
                         }
                     }
 
+//..................Interns the species names, the first occurrence wins. From here on, a species is
+//                  referred to by its ID, i.e. its position in species_names, and the names are only
+//                  used again to print the output. The species unknown to the zone are dropped.
+                    unordered_map<string, int> species_id;
+                    for (int i = 0; i < (int)species_names.size(); i++)
+                        species_id.emplace(species_names[i], i);
+
+                    vector<mpreal> w0(species_names.size(), mpreal("0"));
+                    for (const auto& [name, concentration] : w0_read)
+                    {
+                        auto it = species_id.find(name);
+                        if (it != species_id.end()) w0[it->second] = concentration;
+                    }
+                    vector<char> unknown(species_names.size(), 0);
+                    for (const string& name : w0_pruned)
+                    {
+                        auto it = species_id.find(name);
+                        if (it != species_id.end()) unknown[it->second] = 1;
+                    }
+
+//..................Reads the target species, if any. Only the species that can feed them are solved.
+                    vector<int> targets;
+                    stringstream ss_targets = stringstream(zone.child("targets").child_value()); string target;
+                    while (ss_targets >> target)
+                    {
+                        auto it = species_id.find(target);
+                        if (it != species_id.end())
+                            targets.push_back(it->second);
+                        else
+                            cout << "warning <cnuctran.simulation.from_input()>\nThe target species " << target << " is not tracked in zone '"
+                                 << zone.attribute("name").value() << "'. It is ignored." << endl;
+                    }
+                    if (zone.child("targets") && targets.empty())
+                    {
+                        cout << "fatal-error <cnuctran.simulation.from_input()>\nNone of the target species is tracked in zone '"
+                             << zone.attribute("name").value() << "'." << endl;
+                        exit(1);
+                    }
+
+//..................The populations of the pruned species are unknown. Without targets, they would feed
+//                  every solved species.
+                    if (count(unknown.begin(), unknown.end(), 1) > 0 && targets.empty())
+                        throw (int)errex::PRUNED_W0;
+
 //..................Reads the rxn rates.
-                    map<string, map<string, mpreal>> rxn_rates;
+                    vector<map<string, mpreal>> rxn_rates(species_names.size());
 
                     for (xml_node reaction : zone.child("reaction_rates").children())
                     {
+                        auto it = species_id.find(reaction.attribute("species").value());
+                        if (it == species_id.end()) continue;
                         mpreal rate = mpreal(reaction.attribute("rate").value());
-                        rxn_rates[reaction.attribute("species").value()][reaction.attribute("type").value()] = rate; 
+                        rxn_rates[it->second][reaction.attribute("type").value()] = rate; 
                     }
 
 //ATTENTION!........This is where the code solves for nuclides concentrations.
-                    solver sol = solver(species_names);
-                    build_chains(sol, rxn_rates, zone.child("species").attribute("source").value());
-                    auto w = sol.solve(w0, n, t);
+                    string source = zone.child("species").attribute("source").value();
+                    vector<mpreal> w;
+                    vector<char> pruned;
+                    string type_name;
+                    int type_digits;
+                    switch (__typ__)
+                    {
+                    case STYPE_DOUBLE:
+                        w = solve_zone<double>(species_names, rxn_rates, source, w0, targets, unknown, pruned, n, t, type_name, type_digits);
+                        break;
+                    case STYPE_LONG_DOUBLE:
+                        w = solve_zone<long double>(species_names, rxn_rates, source, w0, targets, unknown, pruned, n, t, type_name, type_digits);
+                        break;
+#ifdef CNUCTRAN_HAVE_FLOAT128
+                    case STYPE_FLOAT128:
+                        w = solve_zone<__float128>(species_names, rxn_rates, source, w0, targets, unknown, pruned, n, t, type_name, type_digits);
+                        break;
+#endif
+                    case STYPE_DD:
+                        w = solve_zone<dd_real>(species_names, rxn_rates, source, w0, targets, unknown, pruned, n, t, type_name, type_digits);
+                        break;
+                    case STYPE_QD:
+                        w = solve_zone<qd_real>(species_names, rxn_rates, source, w0, targets, unknown, pruned, n, t, type_name, type_digits);
+                        break;
+                    case STYPE_FP128:
+                        w = solve_zone<fpreal<2>>(species_names, rxn_rates, source, w0, targets, unknown, pruned, n, t, type_name, type_digits);
+                        break;
+                    case STYPE_FP192:
+                        w = solve_zone<fpreal<3>>(species_names, rxn_rates, source, w0, targets, unknown, pruned, n, t, type_name, type_digits);
+                        break;
+                    case STYPE_FP256:
+                        w = solve_zone<fpreal<4>>(species_names, rxn_rates, source, w0, targets, unknown, pruned, n, t, type_name, type_digits);
+                        break;
+                    case STYPE_FP512:
+                        w = solve_zone<fpreal<8>>(species_names, rxn_rates, source, w0, targets, unknown, pruned, n, t, type_name, type_digits);
+                        break;
+                    default:
+                        if (auto_precision)
+                            w = solve_zone_auto(species_names, rxn_rates, source, w0, targets, unknown, pruned, n, t, output_digits, precision_digits, type_name, type_digits);
+                        else
+                        {
+                            w = solve_zone<mpreal>(species_names, rxn_rates, source, w0, targets, unknown, pruned, n, t, type_name, type_digits);
+                            type_digits = precision_digits;
+                        }
+                        break;
+                    }
+
+//..................A pruned species read from the initial concentrations must be pruned again, i.e. it
+//                  must not feed any target.
+                    for (int i = 0; i < (int)species_names.size(); i++)
+                        if (unknown[i] && !pruned[i]) throw (int)errex::PRUNED_W0;
 
 //..................Prints to output file.
                     stringstream ss_xml("");
@@ -444,7 +695,7 @@ namespace cnuctran {
                            << zone.attribute("name").value() 
                            << "\" amin = \"" << AMin 
                            << "\" amax=\"" << AMax 
-                           << "\" total_nuclides=\"" << sol.species_names.size() 
+                           << "\" total_nuclides=\"" << species_names.size() 
                            << "\" time_step=\"" << t << "\">" << endl;
 
                     file_out << "CNUCTRAN v1.1 OUTPUT." << endl;
@@ -454,18 +705,25 @@ namespace cnuctran {
                     int k = int(floor(log(t / pow(mpreal("10"), -n)) / log(mpreal("2.0"))));
                     mpreal dt = t / pow(mpreal("2.0"), k);
                     file_out << setw(20) << left << "substep" << "= " << scientific << dt << "s (" << k << " sparse mults.)" << endl;
-                    file_out << setw(20) << left << "precision" << "= " << precision_digits << " digits." << endl;
+                    file_out << setw(20) << left << "precision" << "= " << type_digits << " digits (" << type_name << ")." << endl;
                     file_out << setw(8) << left << "Species" << setw(10) << left << "Non-zero" << setw(output_digits + 10) << left << "Concentration" << endl;
 
-                    for (string species : sol.species_names)
+                    for (int i = 0; i < (int)species_names.size(); i++)
                     {
-                        mpreal c = w[species];
+                        const string& species = species_names[i];
+                        const mpreal& c = w[i];
+                        if (pruned[i])
+                        {
+                            ss_xml << "\t\t<concentration species=\"" << species << "\" pruned=\"true\" />" << endl;
+                            ss_out << setw(8) << left << species << " " << setw(10) << "" << left << "pruned" << endl;
+                            continue;
+                        }
                         ss_xml << "\t\t<concentration species=\"" << species 
                             << "\" value=\"" << scientific 
                             << setprecision(output_digits) << c 
                             << "\" />" << endl;
                         ss_out << setw(8) << left << species << " " << setw(10);
-                        w[species] > mpreal("0.0") ? ss_out << left << "yes" : ss_out << "";
+                        c > mpreal("0.0") ? ss_out << left << "yes" : ss_out << "";
                         ss_out << setw(output_digits + 10) << scientific
                                << setprecision(output_digits) << left << c << endl;
 
@@ -508,6 +766,10 @@ namespace cnuctran {
                 case errex::MISSING_W0_SOURCE:
                     cout << "fatal-error <cnuctran.simulation.from_input()>\nCould not open the initial nuclide concentrations XML file." << endl;
                     exit(1);
+                case errex::PRUNED_W0:
+                    cout << "fatal-error <cnuctran.simulation.from_input()>\nThe initial nuclide concentrations XML file lists pruned species, whose concentrations were not computed." << endl;
+                    cout << "They may only be read by a zone whose targets prune the same species again." << endl;
+                    exit(1);
                 default:
                     cout << "fatal-error <cnuctran.simulation.from_input()>\nUnexpected error has occurred." << endl;
                     exit(1);
@@ -10,7 +10,8 @@
 
       This header file contains  the  definitions of SMATRIX class.  SMATRIX enables fast,
       parallelized and accurate sparse binary exponentiation using the arbitrary precision
-      floating-point library, MPFR.
+      floating-point library, MPFR. SMATRIX is templated on the floating-point type, real,
+      see scalar.h.
 
  */
 
@@ -18,7 +19,9 @@
 #define SMATRIX_H
 
 #include <cnuctran.h>
+#include <scalar.h>
 #include <ppl.h>
+#include <mpalloc.h>
 
 using namespace mpfr;
 using namespace concurrency;
@@ -28,19 +31,20 @@ using namespace concurrency;
 namespace cnuctran
 {
 
+    template <typename real>
     class smatrix {
 
     public:
 
         std::pair<int, int> shape;
-        cmap_2d nzel;
+        cmap_2d<real> nzel;
         mpfr_prec_t bits = digits2bits(__dps__);
         /*
             Constructor definitions.
         */
         smatrix(void) { return; }
         smatrix(std::pair<int, int> shape) { this->shape = shape; return; }
-        smatrix(std::pair<int, int> shape, cmap_2d& A)
+        smatrix(std::pair<int, int> shape, cmap_2d<real>& A)
         {
             this->shape = shape; this->nzel = A; return;
         }
@@ -52,29 +56,33 @@ namespace cnuctran
             smatrix result = smatrix(std::pair<int, int>(sx, sy));
 
 
+            real tmp;
+            scalar<real>::prepare(tmp, bits);
             int row;
             for (row = 0; row < sx; row++)
             {
                 auto& c = result.nzel[row];
                 for (const auto& [k1, v1] : this->nzel[row])
                     for (const auto& [k2, v2] : other.nzel[k1])
-                        c[k2] += v1 * v2;
+                        scalar<real>::fma_acc(c[k2], v1, v2, tmp);
             }
             return result;
         }
 
         // Parallel implementation of self sparse matrix-matrix multiplication.
-        cmap_2d smul(void)
+        cmap_2d<real> smul(void)
         {
-            cmap_2d result;
+            cmap_2d<real> result;
             auto& r = result;
-            parallel_for_each(begin(nzel), end(nzel), [&](const std::pair<int, cmap_1d>& p)
+            parallel_for_each(begin(nzel), end(nzel), [&](const std::pair<int, cmap_1d<real>>& p)
                 {
                     mpreal::set_default_prec(bits);
-                    cmap_1d c;
+                    static thread_local real tmp;
+                    scalar<real>::prepare(tmp, bits);
+                    cmap_1d<real> c;
                     for (const auto& [k1, v1] : p.second)
                         for (const auto& [k2, v2] : nzel[k1])
-                            c[k2] += v1 * v2;
+                            scalar<real>::fma_acc(c[k2], v1, v2, tmp);
                     r.insert(make_pair(p.first, c));
                 });
             return result;
@@ -86,7 +94,10 @@ namespace cnuctran
         {
             
             for (int i = 1; i <= k; i++)
+            {
                 nzel = smul();
+                if (mpalloc::is_installed()) mpalloc::release();
+            }
         }
 
     };
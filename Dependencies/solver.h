@@ -10,7 +10,8 @@
 
       This header file contains the definitions of all reusable computational 
       routines of the proposed probabilistic method, which is implemented in
-      CNUCTRAN.
+      CNUCTRAN. SOLVER is templated on the floating-point type of the calculation,
+      real (see scalar.h), while its inputs and outputs are always mpreal.
 
  */
 
@@ -19,6 +20,9 @@
 
 #include <mpreal.h>
 #include <smatrix.h>
+#include <scalar.h>
+#include <csrmatrix.h>
+#include <mpalloc.h>
 #include <cnuctran.h>
 #include <map>
 
@@ -41,23 +45,33 @@ namespace cnuctran
 
     */
 
+    template <typename real>
     class solver
     {
     public:
-        const mpreal __two__ = mpreal("2.0");
-        const mpreal __one__ = mpreal("1.0");
-        const mpreal __neg__ = mpreal("-1.0");
-        const mpreal __zer__ = mpreal("0.0");
+        const real __two__ = real(2);
+        const real __one__ = real(1);
+        const real __neg__ = real(-1);
+        const real __zer__ = real(0);
         vector<string> species_names;
         int __I__;
 
         // lambdas is a 2D vector storing the transmutation constants for all nuclides.
         // Its row corresponds to the various nuclide and its column corresponds to the various removal types.
-        vector<vector<mpreal>> lambdas;
+        vector<vector<real>> lambdas;
 
         // G is a 2D vector storing the transmutation products ID. The ID maps to the nuclide stored in species_names.
         vector<vector<vector<int>>> G;
-        vector<vector<mpreal>> fission_yields;
+        vector<vector<real>> fission_yields;
+
+        // lumped flags the species lumped into their parents for the current step, see LUMP. lumps[i] lists the
+        // long-lived descendants of a lumped species-i and their shares, lump_order lists the lumped species, daughters first.
+        vector<char> lumped;
+        vector<vector<pair<int, real>>> lumps;
+        vector<int> lump_order;
+
+        // renumbered is true for the solver of the renumbered species, which is not renumbered again.
+        bool renumbered = false;
 
         solver(vector<string> species_names)
         {
@@ -65,12 +79,12 @@ namespace cnuctran
             this->__I__ = this->species_names.size();
             for (int i = 0; i < this->__I__; i++)
             {
-                this->lambdas.push_back(vector<mpreal>());
+                this->lambdas.push_back(vector<real>());
                 vector<int> tmp1; 
                 tmp1.push_back(__nop__);
                 vector<vector<int>> tmp2; tmp2.push_back(tmp1);
                 this->G.push_back(tmp2);
-                this->fission_yields.push_back(vector<mpreal>());
+                this->fission_yields.push_back(vector<real>());
             }
             return;
         }
@@ -90,16 +104,16 @@ namespace cnuctran
             if (rate < __mnr__ || rate > __mxr__)
                 return;
 
-            this->lambdas[species_index].push_back(rate);
+            this->lambdas[species_index].push_back(scalar<real>::from_mpreal(rate));
             this->G[species_index].push_back(products);
 
             if (!fission_yields.empty() && products.size() > 1)
             {
                 if (fission_yields.size() >= products.size())
                 {
-                    vector<mpreal> tmp = vector<mpreal>();
-                    for (mpreal y : fission_yields)
-                        tmp.push_back(y);
+                    vector<real> tmp = vector<real>();
+                    for (const mpreal& y : fission_yields)
+                        tmp.push_back(scalar<real>::from_mpreal(y));
                     this->fission_yields[species_index] = tmp;
                 }
                 else
@@ -129,114 +143,747 @@ namespace cnuctran
         }
 
         /*
-            PREPARE_TRANSFER_MATRIX
-            This function returns the transfer matrix, P, in Eq. (17) of CNUCTRAN manual.
+            REACHABLE
+            Flags the species reachable from the non-zero entries of w0, and from the species flagged
+            in unknown, through the products of G. The set is closed, i.e. the products of its species
+            belong to it, and no other species ever receives any population during the step.
         */
-        smatrix prepare_transfer_matrix(mpreal dt)
+        vector<char> reachable(const vector<mpreal>& w0, const vector<char>& unknown = vector<char>()) const
         {
-            cmap_2d A;
-            cmap_2d P;
-            int i;
+            vector<char> seen(this->__I__, 0);
+            vector<int> stack;
+            for (int i = 0; i < this->__I__; i++)
+                if (w0[i] != 0 || (!unknown.empty() && unknown[i])) { seen[i] = 1; stack.push_back(i); }
 
-            unordered_map<int, mpreal> e;
-            
-            for (i = 0; i < this->__I__; i++)
+            while (!stack.empty())
             {
-                    
-
-//..............Clears the exponentials container, e, and retrieves the total number of
-//              events associated to nuclide-i.
-                e.clear();
-                const int n_events = this->G[i].size();
+                const int i = stack.back();
+                stack.pop_back();
+                for (const vector<int>& products : this->G[i])
+                    for (int k : products)
+                        if (k != __nop__ && !seen[k]) { seen[k] = 1; stack.push_back(k); }
+            }
+            return seen;
+        }
 
+        /*
+            FEEDING
+            Flags the target species and the species that can feed any of them, i.e. the species
+            from which a target is reachable through the products of G. The concentrations of the
+            targets do not depend on the other species.
+        */
+        vector<char> feeding(const vector<int>& targets) const
+        {
+            vector<vector<int>> parents(this->__I__);
+            for (int i = 0; i < this->__I__; i++)
+                for (const vector<int>& products : this->G[i])
+                    for (int k : products)
+                        if (k != __nop__) parents[k].push_back(i);
 
-//..............Precalculate the exponentials.
-                mpreal norm = __zer__;
+            vector<char> seen(this->__I__, 0);
+            vector<int> stack;
+            for (int i : targets)
+                if (!seen[i]) { seen[i] = 1; stack.push_back(i); }
 
-                for (int l = 1; l < n_events; l++)
-                    e.emplace(l - 1, exp(-this->lambdas[i][l - 1] * dt));
+            while (!stack.empty())
+            {
+                const int k = stack.back();
+                stack.pop_back();
+                for (int i : parents[k])
+                    if (!seen[i]) { seen[i] = 1; stack.push_back(i); }
+            }
+            return seen;
+        }
 
-//..............Constructs the pi-distribution according to Eq. (12) if CNUCTRAN manual.
-                for (int j = 0; j < n_events; j++)
+        /*
+            BLOCKS
+            Returns the strongly connected components of the chain graph, i.e. of the species linked by
+            the products of G, in topological order: no species feeds a species of an earlier block.
+            Renumbered in this order, the transfer matrix is block lower triangular, its diagonal blocks
+            being the cycles of the chain, e.g. the (n,2n)/(n,gamma) loops, or single species. The
+            species of a block are in ascending order. Tarjan's algorithm, without recursion.
+        */
+        vector<vector<int>> blocks() const
+        {
+            vector<int> index(this->__I__, -1), low(this->__I__, 0), stack, path;
+            vector<size_t> edge(this->__I__, 0);
+            vector<char> on_stack(this->__I__, 0);
+            vector<vector<int>> daughters = this->daughters();
+            vector<vector<int>> result;
+            int counter = 0;
+
+            for (int root = 0; root < this->__I__; root++)
+            {
+                if (index[root] >= 0) continue;
+                path.push_back(root);
+                index[root] = low[root] = counter++;
+                stack.push_back(root); on_stack[root] = 1;
+                while (!path.empty())
                 {
-
-                    auto& p = P[i][j];
-                    p = __one__;
-                    for (int l = 1; l < n_events; l++)
+                    const int i = path.back();
+                    if (edge[i] < daughters[i].size())
                     {
-                        p *= l == j ? __one__ - e[l - 1] : e[l - 1];
+                        const int k = daughters[i][edge[i]++];
+                        if (index[k] < 0)
+                        {
+                            index[k] = low[k] = counter++;
+                            stack.push_back(k); on_stack[k] = 1;
+                            path.push_back(k);
+                        }
+                        else if (on_stack[k])
+                            low[i] = min(low[i], index[k]);
+                        continue;
                     }
-                    norm += p;
+
+//..................All daughters of species-i are visited. It closes a block if it is its root.
+                    path.pop_back();
+                    if (!path.empty()) low[path.back()] = min(low[path.back()], low[i]);
+                    if (low[i] != index[i]) continue;
+                    vector<int> block;
+                    int k;
+                    do
+                    {
+                        k = stack.back(); stack.pop_back(); on_stack[k] = 0;
+                        block.push_back(k);
+                    } while (k != i);
+                    sort(block.begin(), block.end());
+                    result.push_back(block);
+                }
+            }
+
+//..........Tarjan's algorithm closes the daughter blocks before their parents.
+            reverse(result.begin(), result.end());
+            return result;
+        }
+
+        /*
+            GROUPS
+            Returns the independent groups of blocks, i.e. the weakly connected components of the chain
+            graph. No transition links two groups, hence the transfer matrix of a group is a diagonal
+            block of the whole one and the groups are solved separately. The species of a group are in
+            ascending order and the groups are ordered by their first species.
+        */
+        vector<vector<int>> groups() const
+        {
+            vector<int> parent(this->__I__);
+            for (int i = 0; i < this->__I__; i++) parent[i] = i;
+            auto find = [&](int i)
+            {
+                while (parent[i] != i) i = parent[i] = parent[parent[i]];
+                return i;
+            };
+
+            vector<vector<int>> daughters = this->daughters();
+            for (int i = 0; i < this->__I__; i++)
+                for (int k : daughters[i])
+                {
+                    const int a = find(i), b = find(k);
+                    if (a != b) parent[max(a, b)] = min(a, b);
                 }
 
-                if (norm == __zer__)
-                    continue;
+            vector<int> group(this->__I__, -1);
+            vector<vector<int>> result;
+            for (int i = 0; i < this->__I__; i++)
+            {
+                const int r = find(i);
+                if (group[r] < 0) { group[r] = (int)result.size(); result.push_back(vector<int>()); }
+                result[group[r]].push_back(i);
+            }
+            return result;
+        }
+
+        /*
+            ORDERING
+            Returns the species in the order of __rnb__. The topological order lists the blocks of the
+            chain by decay direction, so that the transfer matrix is block lower triangular. The reverse
+            Cuthill-McKee order visits the symmetrized chain graph breadth first from a species of least
+            degree, the neighbours by increasing degree, and is then reversed, so that the entries of
+            the transfer matrix gather around its diagonal. Both keep the rows read together close in
+            memory during the squaring.
+        */
+        vector<int> ordering() const
+        {
+            vector<int> order;
+            if (__rnb__ == RENUMBER_TOPOLOGICAL)
+            {
+                for (const vector<int>& block : this->blocks())
+                    order.insert(order.end(), block.begin(), block.end());
+                return order;
+            }
 
-//..............Constructs the transfer matrix according to Eq. (15) of CNUCTRAN manual.
-                auto const& gI = G[i];
-                for (int j = 0; j < n_events; j++)
+            vector<vector<int>> daughters = this->daughters();
+            vector<vector<int>> neighbours(this->__I__);
+            for (int i = 0; i < this->__I__; i++)
+                for (int k : daughters[i])
                 {
+                    neighbours[i].push_back(k);
+                    neighbours[k].push_back(i);
+                }
+            for (vector<int>& adj : neighbours)
+            {
+                sort(adj.begin(), adj.end());
+                adj.erase(unique(adj.begin(), adj.end()), adj.end());
+            }
+            for (vector<int>& adj : neighbours)
+                stable_sort(adj.begin(), adj.end(),
+                    [&](int x, int y) { return neighbours[x].size() < neighbours[y].size(); });
+
+            vector<int> by_degree(this->__I__);
+            for (int i = 0; i < this->__I__; i++) by_degree[i] = i;
+            stable_sort(by_degree.begin(), by_degree.end(),
+                [&](int x, int y) { return neighbours[x].size() < neighbours[y].size(); });
+
+            vector<char> seen(this->__I__, 0);
+            for (int root : by_degree)
+            {
+                if (seen[root]) continue;
+                seen[root] = 1;
+                size_t head = order.size();
+                order.push_back(root);
+                while (head < order.size())
+                    for (int k : neighbours[order[head++]])
+                        if (!seen[k]) { seen[k] = 1; order.push_back(k); }
+            }
+            reverse(order.begin(), order.end());
+            return order;
+        }
+
+        /*
+            SUBSET
+            Returns the solver of the species ids renumbered from 0, i.e. ids[q] becomes species-q. The
+            removals are kept whole, i.e. the removal rates are unchanged, and a product outside ids
+            is replaced by __nop__, so that its share simply leaves the reduced system. Given in
+            ascending order, the ids keep the order of every sum of the squaring.
+        */
+        solver<real> subset(const vector<int>& ids) const
+        {
+            vector<int> renumbered(this->__I__, __nop__);
+            vector<string> names;
+            for (int q = 0; q < (int)ids.size(); q++)
+            {
+                renumbered[ids[q]] = q;
+                names.push_back(this->species_names[ids[q]]);
+            }
+
+            solver<real> sub = solver<real>(names);
+            for (int q = 0; q < (int)ids.size(); q++)
+            {
+                sub.lambdas[q] = this->lambdas[ids[q]];
+                sub.fission_yields[q] = this->fission_yields[ids[q]];
+                sub.G[q] = this->G[ids[q]];
+                for (vector<int>& products : sub.G[q])
+                    for (int& k : products)
+                        if (k != __nop__) k = renumbered[k];
+            }
+            return sub;
+        }
+
+        /*
+            LUMP
+            Flags the species whose half-life, ln(2) over the sum of their removal rates, is below
+            __lmp__ times the time step t. Such a species decays within a tiny fraction of the step and
+            ends it in equilibrium with its parents, hence it is lumped into them, i.e. every transition
+            into it is redirected to its long-lived descendants, weighted by its branching ratios and
+            yields. The species of a cycle of lumped species are kept. Returns the number of lumped
+            species.
+        */
+        int lump(const mpreal& t)
+        {
+            this->lumped.assign(this->__I__, 0);
+            this->lumps.assign(this->__I__, vector<pair<int, real>>());
+            this->lump_order.clear();
+            if (__lmp__ <= 0) return 0;
+
+            const mpreal limit = log(mpreal(2)) / (mpreal(__lmp__) * t);
+            for (int i = 0; i < this->__I__; i++)
+                if (this->total_rate(i) > limit) this->lumped[i] = 1;
+
+//..........Expands the lumped species depth first. A cycle unflags its first species and the
+//          expansion starts over, which terminates since the flags only go down.
+            bool cyclic = true;
+            while (cyclic)
+            {
+                cyclic = false;
+                vector<char> state(this->__I__, 0);
+                this->lump_order.clear();
+                for (int i = 0; i < this->__I__ && !cyclic; i++)
+                    if (this->lumped[i] && state[i] == 0) cyclic = !this->expand(i, state);
+            }
+            return (int)this->lump_order.size();
+        }
+
+        /*
+            EQUILIBRIUM
+            Reconstructs the concentrations of the lumped species from the final concentrations of the
+            others. A lumped species is in secular equilibrium with its parents, i.e. its removal
+            balances its production: N_s = sum_i lambda_is N_i / Lambda_s. The parents are visited
+            before their lumped daughters.
+        */
+        void equilibrium(vector<mpreal>& w) const
+        {
+            vector<mpreal> production(this->__I__, mpreal(0));
+            auto produce = [&](int i)
+            {
+                if (w[i] == 0) return;
+                for (int j = 1; j < (int)this->G[i].size(); j++)
+                {
+                    const vector<int>& products = this->G[i][j];
+                    const mpreal rate = scalar<real>::to_mpreal(this->lambdas[i][j - 1]) * w[i];
+                    for (int l = 0; l < (int)products.size(); l++)
+                        if (products[l] != __nop__ && this->lumped[products[l]])
+                            production[products[l]] += products.size() > 1 ?
+                                rate * scalar<real>::to_mpreal(this->fission_yields[i][l]) : rate;
+                }
+            };
+
+            for (int i = 0; i < this->__I__; i++)
+                if (!this->lumped[i]) produce(i);
+            for (int q = (int)this->lump_order.size() - 1; q >= 0; q--)
+            {
+                const int s = this->lump_order[q];
+                w[s] = production[s] / this->total_rate(s);
+                produce(s);
+            }
+        }
+
+        /*
+            PREPARE_TRANSFER_MATRIX
+            This function returns the transfer matrix, P, in Eq. (17) of CNUCTRAN manual.
+            The matrix is assembled column by column in a CSC staging buffer, i.e. nuclide-i owns
+            the column-i and the nuclides are processed in parallel without sharing any container.
+            The staging buffer is then transposed into the CSR format.
+        */
+        csrmatrix<real> prepare_transfer_matrix(real dt)
+        {
+            const int n = this->__I__;
+            const mpfr_prec_t prec = mpreal::get_default_prec();
+            vector<vector<pair<int, real>>> columns(n);
+
+//..........The scratch vectors are owned by the threads.
+            parallel_for(0, n, [&](int i)
+                {
+                    mpreal::set_default_prec(prec);
+                    static thread_local vector<real> p, pre, suf;
+                    if (!this->lumped.empty() && this->lumped[i]) return;
+
+//..................Retrieves the total number of events associated to nuclide-i. Event-0 is the
+//                  survival, event-j (j > 0) is the removal of rate lambdas[i][j - 1].
+                    const vector<real>& rates = this->lambdas[i];
+                    const int n_events = this->G[i].size();
+                    const int m = n_events - 1;
+
+//..................Prefix and suffix sums of the rates, so that the sum of the rates of all
+//                  events but one costs a single addition.
+                    pre.resize(m + 1);
+                    suf.resize(m + 1);
+                    pre[0] = __zer__;
+                    for (int l = 0; l < m; l++) pre[l + 1] = pre[l] + rates[l];
+                    suf[m] = __zer__;
+                    for (int l = m - 1; l >= 0; l--) suf[l] = suf[l + 1] + rates[l];
+
+//..................Constructs the pi-distribution according to Eq. (12) if CNUCTRAN manual. The
+//                  event probability, 1 - exp(-lambda dt), is evaluated as -expm1(-lambda dt)
+//                  since it cancels catastrophically for the tiny dt. The product of the survival
+//                  probabilities of the other events is a single exponential of the sum of their
+//                  rates, i.e. it is evaluated in log space.
+                    p.resize(n_events);
+                    real norm = __zer__;
+                    p[0] = scalar<real>::exp(-pre[m] * dt);
+                    norm += p[0];
+                    for (int j = 1; j < n_events; j++)
+                    {
+                        p[j] = -scalar<real>::expm1(-rates[j - 1] * dt) * scalar<real>::exp(-(pre[j - 1] + suf[j]) * dt);
+                        norm += p[j];
+                    }
+
+                    if (norm == __zer__)
+                        return;
 
-                    auto const& a = (P[i][j] / norm);
-                    auto const& gJ = gI[j];
-                    int n_daughters = gJ.size();
-                    for (int l = 0; l < n_daughters; l++)
+//..................Constructs the column-i of the transfer matrix according to Eq. (15) of CNUCTRAN
+//                  manual. The entries of a daughter reached by several events are summed in the
+//                  order of the events.
+                    auto& column = columns[i];
+                    auto const& gI = G[i];
+                    for (int j = 0; j < n_events; j++)
                     {
-                        auto const& k = gJ[l];
-                        if (k != __nop__)
+
+                        real const a = (p[j] / norm);
+                        auto const& gJ = gI[j];
+                        int n_daughters = gJ.size();
+                        for (int l = 0; l < n_daughters; l++)
                         {
-                            n_daughters > 1 ? A[k][i] += a * fission_yields[i][l] :
-                                A[k][i] += a;
+                            auto const& k = gJ[l];
+                            if (k == __nop__) continue;
+                            real const v = n_daughters > 1 ? a * fission_yields[i][l] : a;
+                            if (this->lumped.empty() || !this->lumped[k])
+                                column.push_back(make_pair(k, v));
+                            else
+                                for (auto const& d : this->lumps[k])
+                                    column.push_back(make_pair(d.first, v * d.second));
                         }
-                    }
 
-                    if (j == 0) A[i][i] += a;
+                        if (j == 0) column.push_back(make_pair(i, a));
 
-                }
+                    }
+
+                    stable_sort(column.begin(), column.end(),
+                        [](const pair<int, real>& x, const pair<int, real>& y) { return x.first < y.first; });
+                    int last = -1;
+                    for (int q = 0; q < (int)column.size(); q++)
+                    {
+                        if (last >= 0 && column[last].first == column[q].first)
+                            column[last].second += column[q].second;
+                        else if (++last != q)
+                            column[last] = std::move(column[q]);
+                    }
+                    column.resize(last + 1);
+                });
+
+//..........Transposes the staging buffer into CSR. The integer passes are serial, they visit the
+//          columns in ascending order, hence the column indices of every row come out sorted.
+//          dest maps every staged entry to its position in the CSR arrays.
+            csrmatrix<real> T = csrmatrix<real>(std::pair<int, int>(n, n));
+            vector<int> col_ptr(n + 1, 0);
+            for (int i = 0; i < n; i++)
+            {
+                col_ptr[i + 1] = col_ptr[i] + (int)columns[i].size();
+                for (const auto& entry : columns[i])
+                    T.row_ptr[entry.first + 1]++;
             }
+            for (int k = 0; k < n; k++)
+                T.row_ptr[k + 1] += T.row_ptr[k];
+
+            vector<int> next(T.row_ptr.begin(), T.row_ptr.end() - 1);
+            vector<int> dest(col_ptr[n]);
+            T.col_idx.resize(col_ptr[n]);
+            for (int i = 0; i < n; i++)
+                for (int q = 0; q < (int)columns[i].size(); q++)
+                {
+                    const int d = next[columns[i][q].first]++;
+                    T.col_idx[d] = i;
+                    dest[col_ptr[i] + q] = d;
+                }
 
-            return smatrix({ this->__I__, this->__I__ }, A);
+//..........Moves the values in parallel.
+            T.val.resize(col_ptr[n], scalar<real>::zero(T.bits));
+            parallel_for(0, n, [&](int i)
+                {
+                    for (int q = 0; q < (int)columns[i].size(); q++)
+                        T.val[dest[col_ptr[i] + q]] = std::move(columns[i][q].second);
+                });
+            return T;
         }
 
 
         /*
             SOLVE
             This function solves the final nuclides concentration according to Eq. (18) of CNUCTRAN manual.
+            The initial and the final concentrations are indexed by species ID, i.e. by the position in
+            species_names. If targets are given, only the species that can feed any of them are solved.
+            The others are flagged in pruned, unless they are known to stay at zero, and their
+            concentrations are set to zero. unknown flags the species whose initial concentrations are
+            unknown, i.e. pruned by a previous solve. They are taken as zero but are never known to stay
+            at zero, hence such a species is flagged in pruned if and only if it cannot feed any target.
         */
-        map<string, mpreal> solve(map<string, mpreal> w0,
+        vector<mpreal> solve(const vector<mpreal>& w0,
             mpreal n,
-            mpreal t)
+            mpreal t,
+            const vector<int>& targets,
+            const vector<char>& unknown,
+            vector<char>& pruned)
         {
-            cmap_2d w0_matrix;
-            for (int i = 0; i < this->__I__; i++)
-                if (w0.count(this->species_names[i]) == 1)
-                    w0_matrix[i][0] = w0[this->species_names[i]];
-                    
-            smatrix converted_w0 = smatrix(pair<int, int>(this->__I__, 1), w0_matrix);
+            pruned.assign(this->__I__, 0);
+
+//..........Solves the reduced system of the species reachable from the initial composition, the
+//          others stay at zero, and able to feed the targets, the others are not solved.
+            if (__prn__ || !targets.empty())
+            {
+                vector<char> forward = __prn__ ? this->reachable(w0, unknown) : vector<char>(this->__I__, 1);
+                vector<char> backward = !targets.empty() ? this->feeding(targets) : vector<char>(this->__I__, 1);
+                vector<int> ids;
+                for (int i = 0; i < this->__I__; i++)
+                    if (forward[i] && backward[i]) ids.push_back(i);
+                if ((int)ids.size() < this->__I__)
+                {
+                    if (__vbs__)
+                    {
+                        cout << "Pruning keeps " << ids.size() << " of " << this->__I__ << " species, "
+                             << count(forward.begin(), forward.end(), 1) << " reachable from the initial composition";
+                        if (!targets.empty()) cout << ", " << count(backward.begin(), backward.end(), 1) << " feeding the targets";
+                        cout << "." << endl;
+                    }
+                    vector<mpreal> w0_sub;
+                    for (int id : ids) w0_sub.push_back(w0[id]);
+                    vector<mpreal> w_sub = this->subset(ids).solve(w0_sub, n, t);
+                    vector<mpreal> out(this->__I__, mpreal("0"));
+                    for (int i = 0; i < this->__I__; i++)
+                        pruned[i] = forward[i] && !backward[i];
+                    for (int q = 0; q < (int)ids.size(); q++) out[ids[q]] = w_sub[q];
+                    return out;
+                }
+            }
+
+//..........Solves the independent groups of blocks one by one. The group of a zero initial
+//          composition stays at zero.
+            vector<vector<int>> groups = this->groups();
+            if (groups.size() > 1)
+            {
+                if (__vbs__)
+                {
+                    vector<vector<int>> blocks = this->blocks();
+                    size_t largest = 0;
+                    for (const vector<int>& block : blocks) largest = max(largest, block.size());
+                    cout << "The chain of " << this->__I__ << " species has " << blocks.size() << " blocks, the largest of "
+                         << largest << " species, in " << groups.size() << " independent groups." << endl;
+                }
+                vector<mpreal> out(this->__I__, mpreal("0"));
+                for (const vector<int>& ids : groups)
+                {
+                    vector<mpreal> w0_sub;
+                    bool zero = true;
+                    for (int id : ids) { w0_sub.push_back(w0[id]); zero = zero && w0[id] == 0; }
+                    if (zero) continue;
+                    vector<mpreal> w_sub = this->subset(ids).solve(w0_sub, n, t);
+                    for (int q = 0; q < (int)ids.size(); q++) out[ids[q]] = w_sub[q];
+                }
+                return out;
+            }
+
+//..........Solves the renumbered species and permutes their concentrations back.
+            if (__rnb__ != RENUMBER_NONE && !this->renumbered)
+            {
+                vector<int> order = this->ordering();
+                vector<mpreal> w0_sub;
+                for (int id : order) w0_sub.push_back(w0[id]);
+                solver<real> sub = this->subset(order);
+                sub.renumbered = true;
+                vector<mpreal> w_sub = sub.solve(w0_sub, n, t);
+                vector<mpreal> out(this->__I__);
+                for (int q = 0; q < (int)order.size(); q++) out[order[q]] = w_sub[q];
+                return out;
+            }
 
             //..........Auto suggest the no. of Sparse Self Matrix Multiplication.
-            int k = int(floor(log(t / pow(mpreal("10"), -n)) / log(__two__)));
+            int k = int(floor(log(t / pow(mpreal("10"), -n)) / log(mpreal("2.0"))));
             if (__vbs__) cout << "Approximation order, n = " << n << endl;
 
+//..........Lumps the ultra-short-lived species into their parents. Their initial concentrations are
+//          passed on to their long-lived descendants.
+            vector<mpreal> w0_lumped = w0;
+            if (this->lump(t) > 0)
+            {
+                if (__vbs__) cout << "Lumping " << this->lump_order.size() << " of " << this->__I__ << " species into their parents." << endl;
+                for (int s : this->lump_order)
+                {
+                    if (w0[s] == 0) continue;
+                    for (auto const& d : this->lumps[s])
+                        w0_lumped[d.first] += w0[s] * scalar<real>::to_mpreal(d.second);
+                    w0_lumped[s] = 0;
+                }
+            }
+
+            cmap_2d<real> w0_matrix;
+            for (int i = 0; i < this->__I__; i++)
+                if (w0_lumped[i] != 0)
+                    w0_matrix[i][0] = scalar<real>::from_mpreal(w0_lumped[i]);
+                    
+            smatrix<real> converted_w0 = smatrix<real>(pair<int, int>(this->__I__, 1), w0_matrix);
+
             //..........Compute the transfer matrix power.
             if (__vbs__) cout << "Time step, T = " << t << endl;
             auto t1 = chrono::high_resolution_clock::now();
-            smatrix T = this->prepare_transfer_matrix(t / pow(__two__, k));
+            csrmatrix<real> Tc = this->prepare_transfer_matrix(scalar<real>::from_mpreal(t / pow(mpreal("2.0"), k)));
+            if (__vbs__) mpalloc::report("transfer matrix");
 
             auto t2 = chrono::high_resolution_clock::now();
             //..........Compute the matrix exponentiation and multiply with w0 to obtain w.
-            T.binpow(k);
-            smatrix w = T.mul(converted_w0);
+            vector<mpreal> out(this->__I__);
+            if (__fmt__ == MFORMAT_CSR)
+            {
+                csrmatrix<real> w0c = csrmatrix<real>(converted_w0);
+                csrmatrix<real> w;
+                if (__mxp__ == 0 || !mixed_precision_solve(Tc, w0c, k, w))
+                {
+                    if (__fxb__ > 0)
+                        Tc = fixed_point_binpow(Tc, k);
+                    else
+                        Tc.binpow(k);
+                    w = Tc.mul(w0c);
+                }
+                for (int i = 0; i < this->__I__; i++)
+                    out[i] = scalar<real>::to_mpreal(w.get(i, 0));
+            }
+            else
+            {
+                smatrix<real> T = Tc.to_smatrix();
+                T.binpow(k);
+                smatrix<real> w = T.mul(converted_w0);
+                for (int i = 0; i < this->__I__; i++)
+                    out[i] = scalar<real>::to_mpreal(w.nzel[i][0]);
+            }
+            if (!this->lump_order.empty()) this->equilibrium(out);
             auto t3 = chrono::high_resolution_clock::now();
+            if (__vbs__) mpalloc::report("squaring");
             if (__vbs__) cout << "Done computing concentrations. ";
             if (__vbs__) cout << chrono::duration_cast<chrono::milliseconds>(t3 - t1).count() << "ms. (" <<
                 chrono::duration_cast<chrono::milliseconds>(t3 - t2).count() << "ms. for " << k << " mults.)" << endl;
 
-            map<string, mpreal> out;
-            for (int i = 0; i < this->__I__; i++)
-                out[this->species_names[i]] = w.nzel[i][0];
             return out;
         }
+
+        vector<mpreal> solve(const vector<mpreal>& w0, mpreal n, mpreal t)
+        {
+            vector<char> pruned;
+            return this->solve(w0, n, t, vector<int>(), vector<char>(), pruned);
+        }
+
+        /*
+            FIXED_POINT_BINPOW
+            Raises the transfer matrix to the power 2^k in fixed point, see fxreal.h. The number of
+            fractional limbs is the smallest of 2, 3, 4 or 8 covering __fxb__ bits. The result is
+            converted back to real, so that w0 is multiplied in floating point.
+        */
+        csrmatrix<real> fixed_point_binpow(const csrmatrix<real>& T, int k)
+        {
+            if (__fxb__ <= 2 * GMP_NUMB_BITS) return fixed_point_binpow<2>(T, k);
+            if (__fxb__ <= 3 * GMP_NUMB_BITS) return fixed_point_binpow<3>(T, k);
+            if (__fxb__ <= 4 * GMP_NUMB_BITS) return fixed_point_binpow<4>(T, k);
+            return fixed_point_binpow<8>(T, k);
+        }
+
+        /*
+            MIXED_PRECISION_SOLVE
+            Squares the transfer matrix twice in the cheap fpreal types and multiplies both powers
+            with w0 at the working precision. The rounding error of the squaring grows roughly like
+            2^k ulp, hence the first type is the smallest fpreal with k + 3.33 __mxp__ + 32 bits, and
+            the second one is the next wider fpreal. If the two sets of concentrations agree to
+            __mxp__ digits, the second one is stored in w and true is returned. Otherwise, or if the
+            cheap types are not narrower than the working precision, false is returned and the caller
+            squares at the working precision. Both runs share the transfer matrix built at the
+            working precision, so only the rounding errors of the squaring are checked.
+        */
+        bool mixed_precision_solve(const csrmatrix<real>& T, csrmatrix<real>& w0, int k, csrmatrix<real>& w)
+        {
+            const int bits = k + (int)ceil(3.33 * __mxp__) + 32;
+            const int working_bits = (int)digits2bits(scalar<real>::digits());
+            if (bits <= fpreal<2>::bits && fpreal<3>::bits < working_bits)
+                return mixed_precision_solve<2, 3>(T, w0, k, w);
+            if (bits <= fpreal<3>::bits && fpreal<4>::bits < working_bits)
+                return mixed_precision_solve<3, 4>(T, w0, k, w);
+            if (bits <= fpreal<4>::bits && fpreal<8>::bits < working_bits)
+                return mixed_precision_solve<4, 8>(T, w0, k, w);
+            if (__vbs__) cout << "Mixed-precision squaring needs " << bits << " bits, it is not cheaper than the working precision." << endl;
+            return false;
+        }
+
+        template <int N, int M>
+        bool mixed_precision_solve(const csrmatrix<real>& T, csrmatrix<real>& w0, int k, csrmatrix<real>& w)
+        {
+            auto t1 = chrono::high_resolution_clock::now();
+            csrmatrix<fpreal<N>> X = T.template convert<fpreal<N>>();
+            X.binpow(k);
+            csrmatrix<real> w_lo = X.template convert<real>().mul(w0);
+            X = csrmatrix<fpreal<N>>();
+
+            csrmatrix<fpreal<M>> Y = T.template convert<fpreal<M>>();
+            Y.binpow(k);
+            csrmatrix<real> w_hi = Y.template convert<real>().mul(w0);
+            auto t2 = chrono::high_resolution_clock::now();
+
+            const mpreal tol = pow(mpreal(10), -__mxp__);
+            for (int i = 0; i < this->__I__; i++)
+            {
+                mpreal a = scalar<real>::to_mpreal(w_lo.get(i, 0));
+                mpreal b = scalar<real>::to_mpreal(w_hi.get(i, 0));
+                if (abs(a - b) > tol * abs(b))
+                {
+                    if (__vbs__) cout << "Mixed-precision squaring disagrees at " << this->species_names[i] << " ("
+                                      << a << " vs. " << b << "). Squaring at the working precision." << endl;
+                    return false;
+                }
+            }
+            if (__vbs__) cout << "Mixed-precision squaring (" << scalar<fpreal<N>>::name() << ", " << scalar<fpreal<M>>::name()
+                              << ") agrees to " << __mxp__ << " digits in " << chrono::duration_cast<chrono::milliseconds>(t2 - t1).count() << "ms." << endl;
+            w = w_hi;
+            return true;
+        }
+
+        template <int F>
+        csrmatrix<real> fixed_point_binpow(const csrmatrix<real>& T, int k)
+        {
+            csrmatrix<fxreal<F>> X = T.template convert<fxreal<F>>();
+            X.binpow(k);
+            fxreal<F>::report(X.val, T.bits);
+            return X.template convert<real>();
+        }
+
+    private:
+
+        // Returns the distinct daughters of every species, itself excluded, in ascending order.
+        vector<vector<int>> daughters() const
+        {
+            vector<vector<int>> result(this->__I__);
+            for (int i = 0; i < this->__I__; i++)
+            {
+                for (int j = 1; j < (int)this->G[i].size(); j++)
+                    for (int k : this->G[i][j])
+                        if (k != __nop__ && k != i) result[i].push_back(k);
+                sort(result[i].begin(), result[i].end());
+                result[i].erase(unique(result[i].begin(), result[i].end()), result[i].end());
+            }
+            return result;
+        }
+
+        // Returns the sum of the removal rates of species-i.
+        mpreal total_rate(int i) const
+        {
+            mpreal r = 0;
+            for (const real& rate : this->lambdas[i]) r += scalar<real>::to_mpreal(rate);
+            return r;
+        }
+
+        // Fills lumps[s] with the long-lived descendants of the lumped species-s and their shares,
+        // merged and sorted by ID. Returns false, and unflags species-s, if s lies on a cycle.
+        bool expand(int s, vector<char>& state)
+        {
+            state[s] = 1;
+            const mpreal total = this->total_rate(s);
+            vector<pair<int, mpreal>> shares;
+            for (int j = 1; j < (int)this->G[s].size(); j++)
+            {
+                const vector<int>& products = this->G[s][j];
+                const mpreal branching = scalar<real>::to_mpreal(this->lambdas[s][j - 1]) / total;
+                for (int l = 0; l < (int)products.size(); l++)
+                {
+                    const int k = products[l];
+                    if (k == __nop__) continue;
+                    const mpreal f = products.size() > 1 ? branching * scalar<real>::to_mpreal(this->fission_yields[s][l]) : branching;
+                    if (!this->lumped[k])
+                    {
+                        shares.push_back(make_pair(k, f));
+                        continue;
+                    }
+                    if (state[k] == 1) { this->lumped[k] = 0; return false; }
+                    if (state[k] == 0 && !this->expand(k, state)) return false;
+                    for (auto const& d : this->lumps[k])
+                        shares.push_back(make_pair(d.first, f * scalar<real>::to_mpreal(d.second)));
+                }
+            }
+
+            stable_sort(shares.begin(), shares.end(),
+                [](const pair<int, mpreal>& x, const pair<int, mpreal>& y) { return x.first < y.first; });
+            vector<pair<int, real>>& out = this->lumps[s];
+            for (int q = 0; q < (int)shares.size(); q++)
+            {
+                if (q > 0 && shares[q - 1].first == shares[q].first)
+                    shares[q].second += shares[q - 1].second;
+                if (q + 1 == (int)shares.size() || shares[q + 1].first != shares[q].first)
+                    out.push_back(make_pair(shares[q].first, scalar<real>::from_mpreal(shares[q].second)));
+            }
+            state[s] = 2;
+            this->lump_order.push_back(s);
+            return true;
+        }
     };
 }
 
@@ -0,0 +1,86 @@
+/*
+      This file is part of the CNUCTRAN source code.
+      
+      @author   M. R. Omar (rabieomar@usm.my)
+      @license  MIT
+      @link     https://github.com/rabieomar92/cnuctran
+      
+      Copyright (c) 2023, Universiti Sains Malaysia.
+      
+      Squares the same transfer matrix at 20 and then at 100 digits, and at 100 and then at
+      20 digits, in one process. The accumulators of the CSR kernel are reused between the
+      squarings, hence every squaring must give the result of a fresh process, which is
+      obtained by running this program again with the precision digits as argument. The
+      program returns 0 if all results agree, 1 otherwise. It is built like cnuctran, from
+      this directory, with ..\Dependencies in the include path.
+      
+ */
+
+#include <simulation.h>
+#include <iostream>
+#include <cstdio>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+using namespace cnuctran;
+
+// Returns the entry (0, 0) of T^(2^40), where T = [[a, 0], [1 - a, 1]] and a = 1 - 1e-25, squared at
+// the given precision digits. a rounds to one below 25 digits.
+static mpreal square(int digits)
+{
+    __dps__ = digits;
+    mpreal::set_default_prec(digits2bits(digits));
+    const mpreal a = mpreal(1) - mpreal("1e-25");
+    cmap_2d<mpreal> entries;
+    entries[0][0] = a;
+    entries[1][0] = mpreal(1) - a;
+    entries[1][1] = mpreal(1);
+    csrmatrix<mpreal> T = csrmatrix<mpreal>(pair<int, int>(2, 2), entries);
+    T.binpow(40);
+    return T.get(0, 0);
+}
+
+// Returns the result printed by a fresh process squaring at the given precision digits.
+static string fresh(const string& program, int digits)
+{
+    string result;
+    FILE* pipe = popen(("\"" + program + "\" " + to_string(digits)).c_str(), "r");
+    if (!pipe) return result;
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), pipe)) result += buffer;
+    pclose(pipe);
+    return trim(result);
+}
+
+static bool check(const string& program, int digits, const mpreal& x)
+{
+    const string expected = fresh(program, digits);
+    const string obtained = x.toString();
+    const bool passed = obtained == expected && x.get_prec() == digits2bits(digits);
+    cout << (passed ? "PASSED" : "FAILED") << ": " << digits << " digits gives " << obtained
+         << ", a fresh process gives " << expected << "." << endl;
+    return passed;
+}
+
+int main(int nargs, char** argv)
+{
+    if (nargs == 2)
+    {
+        cout << square(stoi(argv[1])).toString() << endl;
+        return 0;
+    }
+
+    bool passed = true;
+    const mpreal low_first = square(20);
+    const mpreal high_second = square(100);
+    const mpreal high_first = square(100);
+    const mpreal low_second = square(20);
+    passed = check(argv[0], 20, low_first) && passed;
+    passed = check(argv[0], 100, high_second) && passed;
+    passed = check(argv[0], 100, high_first) && passed;
+    passed = check(argv[0], 20, low_second) && passed;
+    return passed ? 0 : 1;
+}
@@ -19,6 +19,19 @@ using namespace cnuctran;
 int main(int nargs, char** argv)
 {
 
+    // cnuctran -convert chain.xml chain.bin writes the binary image of a nuclides data file.
+    if (nargs == 4 && string(argv[1]) == "-convert")
+    {
+        shared_ptr<const nuclide_library> library = nuclide_library::get(argv[2]);
+        if (!library || !library->save(argv[3]))
+        {
+            cout << "fatal-error <cnuctran.main(...)>\nFailed converting " << argv[2] << " into " << argv[3] << "." << endl;
+            return 1;
+        }
+        cout << argv[2] << " converted into " << argv[3] << ", " << library->nuclides.size() << " nuclides." << endl;
+        return 0;
+    }
+
     nargs == 2? 
         simulation::from_input(argv[1]) :
         simulation::from_input(".\\input.xml");